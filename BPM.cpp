@@ -6,12 +6,16 @@
 #include <map>
 #include <stack>
 #include <fstream>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
 
 #include "src/config.h"
 #include "src/trie.h"
 #include "src/helpers.h"
 #include "src/minmaxpst.h"
 #include "src/fastaReader.h"
+#include "src/parallel.h"
 
 #define DEBUG
 #ifdef DEBUG
@@ -26,9 +30,29 @@ int main(int argc, char *argv[]) {
 	std::string dbFile;
 	std::string modFile;
 	std::string aaFile;
+	size_t nrThreads = defaultThreads();
+	MassTolerance tolerance = { 0, 0 };
+	size_t limit = std::numeric_limits<size_t>::max();
+	bool countOnly = false;
+	size_t cacheNodes = 0;
+	// the results are written through the stream buffer, not flushed line by line
+	std::ios::sync_with_stdio(false);
+
+	// flags may be given anywhere, the other arguments are positional
+	std::vector<char*> args;
+	for (int i = 0; i < argc; i++) {
+		if (std::string(argv[i]) == "--count")
+			countOnly = true;
+		else if (std::string(argv[i]).compare(0, 8, "--cache=") == 0)
+			cacheNodes = strtoull(argv[i] + 8, nullptr, 10);
+		else
+			args.push_back(argv[i]);
+	}
+	argc = args.size();
+	argv = args.data();
 	
 	if (argc < 2) {
-		std::cout << "USAGE: " << argv[0] << " <DB file (fasta)> [<post-translational modifications file (cfg/modifications.cfg)> <AA masses file (cfg/aminoacids.cfg)>]" << std::endl;
+		std::cout << "USAGE: " << argv[0] << " [--count] [--cache=<nr of nodes>] <DB file (fasta)> [<post-translational modifications file (cfg/modifications.cfg)> <AA masses file (cfg/aminoacids.cfg)> <nr of threads (all cores)> <mass tolerance in mass units or ppm, e.g. 10ppm (0)> <max nr of matches per pattern (0 = all)>]" << std::endl;
 		return 1;
 	} else {
 //		bpFile = argv[1];
@@ -42,28 +66,43 @@ int main(int argc, char *argv[]) {
 		aaFile = argv[3];
 	else
 		aaFile = "cfg/aminoacids.cfg";
+	if (argc > 4)
+		nrThreads = std::max<size_t>(1, strtoull(argv[4], nullptr, 10));
+	if (argc > 5 && !readMassTolerance(argv[5], tolerance)) {
+		std::cout << "ERROR: unknown mass tolerance " << argv[5] << std::endl;
+		return 1;
+	}
+	if (argc > 6 && strtoull(argv[6], nullptr, 10) > 0 && !countOnly)
+		limit = strtoull(argv[6], nullptr, 10);
 	LOG("Program: " + std::string(argv[0]));
 	LOG("DB File: " + dbFile);
 	LOG("PTM File: " + modFile);
 	LOG("AAmasses File: " + aaFile);
+	LOG("Threads: " + std::to_string(nrThreads));
+	LOG("Mass tolerance: " + std::to_string(tolerance.absolute) + " + " + std::to_string(tolerance.ppm) + "ppm");
+	if (limit < std::numeric_limits<size_t>::max())
+		LOG("Matches per pattern: " + std::to_string(limit));
+	if (countOnly)
+		LOG("Count only");
+	LOG("Cache (nodes): " + std::to_string(cacheNodes));
 
 	cfg::loadConfig(aaFile,modFile);
 
 	// read DB File
 	auto begin = std::chrono::high_resolution_clock::now();
-	std::map< size_t, MinMaxPST > psts;
+	MassDirectory psts;
 	MinMaxPST* leaves = nullptr;
-	std::vector< std::pair<size_t,size_t> > trie;
-	std::map< size_t, std::string > leafSeqs;
+	TrieTable trie;
+	LeafTable leafSeqs;
 
 #ifdef MOD_TOLERANT
-	std::map<size_t,std::map<char,size_t>> lastOcc;
+	LastOccTable lastOcc;
 	readDBFileMod( dbFile, psts, leaves, trie, leafSeqs, lastOcc );
 #else
 #ifdef MUT_TOLERANT
-	std::unordered_map< size_t, std::vector<size_t> > links;
+	LinkTable links;
 	readDBFileMut( dbFile, psts, leaves, trie, leafSeqs, links );
-	if (links.size() == 0)
+	if (links.empty())
 		std::cout << "Warnings: no links in DB index - probably index file has not been generated for mutation-tolerant BPM" << std::endl;
 #else
 	readDBFile( dbFile, psts, leaves, trie, leafSeqs );
@@ -83,55 +122,175 @@ int main(int argc, char *argv[]) {
 
 #ifdef MUT_TOLERANT
 	std::cout << "Mutation-tolerant blocked pattern matching" << std::endl;
+	const bool exactSearch = false;
+#else
+#ifdef MOD_TOLERANT
+	const bool exactSearch = !modifications;
+#else
+	const bool exactSearch = true;
 #endif
+#endif
+	if (!tolerance.exact() && !exactSearch) {
+		std::cout << "ERROR: a mass tolerance is only supported for standard blocked pattern matching" << std::endl;
+		return 1;
+	}
 
-	begin = std::chrono::high_resolution_clock::now();
-	std::string line;
-	std::vector<size_t> bp;
-	size_t count = 0;
-	while(getline(std::cin, line)) {
-		if (line.size() == 0)
-			break;
-		if (line.at(0) == '#') {
-			std::cout << line << std::endl;
-			continue;
+	// standard matching without tolerance answers a chunk with findBPBatch, one batch per thread,
+	// so that patterns with common leading blocks share their search; with --cache, the batches of all
+	// chunks also share the nodes matched by leading blocks through one cache
+	const bool batch = exactSearch && tolerance.exact();
+	FrontierCache cache(cacheNodes);
+
+	std::vector<std::string> lines;
+	std::vector< std::vector<size_t> > bps;
+
+	// the results of a chunk are written in input order as they are found: the thread that answers the first
+	// pattern not written yet (head) writes its results whenever outputBuffer bytes are collected, the others
+	// wait once they have collected outputBuffer bytes of a pattern, and keep the results of the patterns they
+	// finish before head until it reaches them. Each thread answers its patterns in input order and the patterns
+	// before them are taken by other threads, so head is never a pattern of a waiting thread
+	const size_t outputBuffer = 1 << 16;
+	std::mutex outputMutex;
+	std::condition_variable written;
+	size_t head = 0;
+	std::vector<std::string> outputs;	// of the finished patterns after head
+	std::vector<bool> finished;
+	auto flush = [&](size_t i, std::string& out, bool complete) {
+		std::unique_lock<std::mutex> lock(outputMutex);
+		if (!complete)
+			written.wait(lock, [&]() { return head == i; });
+		if (head != i) {
+			outputs[i].swap(out);
+			finished[i] = true;
+			return;
 		}
-		readBP(line,bp);
-//		std::cout << "BP: ";
-//		for ( auto a : bp )
-//			std::cout << a << " ";
-//		std::cout << std::endl;
-		if (bp.size() == 0)
-			continue;
-		count++;
-#ifdef MUT_TOLERANT
-//		findBPMut(bp,psts,links,trie,*leaves,leafSeqs);
-		std::vector<std::string> results = findBPMut(bp,psts,links,trie,*leaves,leafSeqs);
-//		if (results.size() > 0) {
-//			std::cout << "Nr of hits: " << results.size() << std::endl;
-//		}
-		for ( auto r : results ) {
-			std::cout << r << std::endl;
+		std::cout << out;
+		out.clear();
+		if (!complete)
+			return;
+		for (head++; head < lines.size() && finished[head]; head++) {
+			std::cout << outputs[head];
+			std::string().swap(outputs[head]);
+		}
+		written.notify_all();
+	};
+
+	// results of line i: one line per match (at most limit), or the line itself for comments.
+	// With --count, the results are one line with the nr of matches and the nr of leaves below them
+	struct Answer {
+		size_t i;
+		std::string out;
+		size_t n;				// nr of matches written
+		MatchCount counted;
+	};
+	auto start = [&](Answer& a, size_t i) {
+		a.i = i;
+		a.out.clear();
+		a.n = 0;
+		a.counted = { 0, 0 };
+		if (lines[i].at(0) == '#')
+			a.out += lines[i] + "\n";
+	};
+	auto finish = [&](Answer& a) {
+		if (countOnly && lines[a.i].at(0) != '#' && bps[a.i].size() > 0)
+			a.out += std::to_string(a.counted.matches) + "\t" + std::to_string(a.counted.leaves) + "\n";
+		flush(a.i, a.out, true);
+	};
+	auto write = [&](Answer& a, const std::string& r) {
+		a.out += r;
+		a.out += '\n';
+		if (a.out.size() >= outputBuffer)
+			flush(a.i, a.out, false);
+		return ++a.n < limit;
+	};
+	auto visit = [&](Answer& a, size_t r) {
+		if (countOnly) {
+			a.counted.matches++;
+			a.counted.leaves += countLeaves(r, trie, leafSeqs);
+			return true;
 		}
+		MinMaxPST_Node node = {r, trie.at(r).first};
+		return write( a, getProteins( node, *leaves, trie, leafSeqs) );
+	};
+	// the patterns of a batch are visited in input order, those without matches are not visited
+	auto answerBatch = [&](size_t first, size_t last) {
+		Answer a;
+		start(a, first);
+		findBPBatch(bps, first, last, psts, [&](size_t p, size_t r) {
+				for (; a.i < p; start(a, a.i+1))
+					finish(a);
+				return visit(a, r);
+			}, cacheNodes > 0 ? &cache : nullptr);
+		for (; a.i+1 < last; start(a, a.i+1))
+			finish(a);
+		finish(a);
+	};
+	auto answer = [&](size_t i) {
+		Answer a;
+		start(a, i);
+		if (lines[i].at(0) != '#' && bps[i].size() > 0) {
+#ifdef MUT_TOLERANT
+			findBPMut(bps[i],psts,links,trie,*leaves,leafSeqs, [&](const std::string& r, size_t v) {
+				if (!countOnly)
+					return write(a, r);
+				a.counted.matches++;
+				a.counted.leaves += countLeaves(v, trie, leafSeqs);
+				return true;
+			});
 #else
-		std::vector<size_t> results;
 #ifdef MOD_TOLERANT
-		if (modifications)
-			results = findBPMod(bp,psts,trie,lastOcc);
-		else
-			results = findBP(bp,psts);
-#else
-		results = findBP(bp,psts);
+			if (modifications)
+				findBPMod(bps[i],psts,trie,lastOcc,[&](size_t r) { return visit(a, r); });
+			else
 #endif
-		for ( auto r : results ) {
-			MinMaxPST_Node n = {r, trie.at(r).first};
-			std::cout << getProteins( n, *leaves, trie, leafSeqs) << std::endl;
-//			getProteins( n, *leaves, trie, leafSeqs); // only for benchmark
-		}
+			findBP(bps[i],psts,tolerance,[&](size_t r) { return visit(a, r); });
 #endif
+		}
+		finish(a);
+	};
+
+	// the patterns are read in chunks and answered on nrThreads threads sharing the index
+	begin = std::chrono::high_resolution_clock::now();
+	const size_t chunkSize = 256*nrThreads;
+	std::string line;
+	size_t count = 0;
+	bool done = false;
+	while (!done) {
+		lines.clear();
+		while (lines.size() < chunkSize) {
+			if (!getline(std::cin, line) || line.size() == 0) {
+				done = true;
+				break;
+			}
+			lines.push_back(line);
+		}
+		if (lines.empty())
+			break;
+		bps.assign(lines.size(), std::vector<size_t>());
+		for (size_t i = 0; i < lines.size(); i++) {
+			if (lines[i].at(0) == '#')
+				continue;
+			readBP(lines[i], bps[i]);
+			if (bps[i].size() > 0)
+				count++;
+		}
+		head = 0;
+		outputs.assign(lines.size(), std::string());
+		finished.assign(lines.size(), false);
+		if (batch) {
+			const size_t nrBatches = std::min(nrThreads, lines.size());
+			parallelFor(nrBatches, [&](size_t k) {
+					answerBatch(lines.size() * k / nrBatches, lines.size() * (k+1) / nrBatches);
+				}, nrThreads);
+		} else
+			parallelFor(lines.size(), answer, nrThreads);
+		std::cout.flush();
 	}
 	end = std::chrono::high_resolution_clock::now();
 	diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
 	std::cout << count << " block pattern matchings (in milliseconds): " << diff << std::endl;
+	if (cacheNodes > 0)
+		LOG("Cache: " + std::to_string(cache.getHits()) + " hits, " + std::to_string(cache.getMisses()) + " misses, "
+			+ std::to_string(cache.size()) + " entries with " + std::to_string(cache.getNodes()) + " nodes");
 }
 
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <limits>
+
+#include "src/minmaxpst.h"
+
+// random points with distinct x and distinct y coordinates, in random order
+std::vector< BasicMinMaxPST<uint32_t>::Node > randomPoints(size_t n, std::mt19937& gen) {
+	std::vector<uint32_t> y(n);
+	for (size_t i = 0; i < n; i++)
+		y[i] = i;
+	std::shuffle(y.begin(), y.end(), gen);
+	std::vector< BasicMinMaxPST<uint32_t>::Node > res;
+	res.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		res.push_back( std::make_pair(static_cast<uint32_t>(i), y[i]) );
+	std::shuffle(res.begin(), res.end(), gen);
+	return res;
+}
+
+// run f repeats times and return the average time in milliseconds
+double timeIt(size_t repeats, const std::function<void()>& f) {
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (size_t r = 0; r < repeats; r++)
+		f();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - begin).count() / repeats;
+}
+
+// PST construction: build vs. buildBySorting
+void benchmarkBuild(const std::vector<size_t>& sizes) {
+	std::mt19937 gen(42);
+	std::cout << "points\tbuild (ms)\tbuildBySorting (ms)\tspeedup" << std::endl;
+	for (auto n : sizes) {
+		const std::vector< BasicMinMaxPST<uint32_t>::Node > points = randomPoints(n, gen);
+		const size_t repeats = std::max<size_t>(1, 1000000 / std::max<size_t>(n, 1));
+		std::vector< BasicMinMaxPST<uint32_t>::Node > a;
+		const double fast = timeIt(repeats, [&]() { a = points; BasicMinMaxPST<uint32_t>::build(a); });
+		std::vector< BasicMinMaxPST<uint32_t>::Node > b;
+		const double slow = timeIt(repeats, [&]() { b = points; BasicMinMaxPST<uint32_t>::buildBySorting(b); });
+		if (a != b)
+			std::cout << "ERROR: build and buildBySorting differ for " << n << " points" << std::endl;
+		std::cout << n << "\t" << fast << "\t" << slow << "\t" << slow / fast << std::endl;
+	}
+}
+
+// queries on the heap and the blocked layout of the same PST
+void benchmarkLayout(const std::vector<size_t>& sizes) {
+	std::mt19937 gen(42);
+	const size_t queries = 1000000;
+	std::cout << "points\tquery\theap (ns)\tblocked (ns)\tspeedup" << std::endl;
+	for (auto n : sizes) {
+		std::vector<MinMaxPST_Node> points;
+		points.reserve(n);
+		for (auto p : randomPoints(n, gen))
+			points.push_back( MinMaxPST_Node(p) );
+		const MinMaxPST heap(points, sizeof(uint32_t), PST_LAYOUT_HEAP);
+		const MinMaxPST blocked(points, sizeof(uint32_t), PST_LAYOUT_BLOCKED);
+		std::vector<MinMaxPST_Node> q(queries);
+		for (auto& o : q)
+			o = std::make_pair(gen() % n, gen() % n);
+
+		const std::vector< std::pair< std::string, std::function<MinMaxPST_Node(const MinMaxPST&, const MinMaxPST_Node&)> > > kinds = {
+			{ "leftmostNE", [](const MinMaxPST& pst, const MinMaxPST_Node& o) { return pst.leftmostNE(o); } },
+			{ "leftmostSE", [](const MinMaxPST& pst, const MinMaxPST_Node& o) { return pst.leftmostSE(o); } },
+			{ "highestNE", [](const MinMaxPST& pst, const MinMaxPST_Node& o) { return pst.highestNE(o); } }
+		};
+		for (auto& k : kinds) {
+			size_t sumHeap = 0, sumBlocked = 0;
+			const double h = timeIt(1, [&]() { for (auto& o : q) sumHeap += k.second(heap, o).first; });
+			const double b = timeIt(1, [&]() { for (auto& o : q) sumBlocked += k.second(blocked, o).first; });
+			if (sumHeap != sumBlocked)
+				std::cout << "ERROR: heap and blocked layout differ for " << k.first << std::endl;
+			std::cout << n << "\t" << k.first << "\t" << 1e6 * h / queries << "\t" << 1e6 * b / queries << "\t" << h / b << std::endl;
+		}
+	}
+}
+
+// enumerateUp for a batch of query points: one query at a time vs. all in one traversal
+void benchmarkBatch(const std::vector<size_t>& sizes) {
+	std::mt19937 gen(42);
+	const size_t batch = 1000;
+	const size_t batches = 100;
+	std::cout << "points\tsingle (ms)\tbatched (ms)\tspeedup" << std::endl;
+	for (auto n : sizes) {
+		std::vector<MinMaxPST_Node> points;
+		points.reserve(n);
+		for (auto p : randomPoints(n, gen))
+			points.push_back( MinMaxPST_Node(p) );
+		const MinMaxPST pst(points, sizeof(uint32_t));
+		// about 50 points per query, as for the nodes of one mass below a trie node
+		std::vector< std::vector<MinMaxPST_Node> > q(batches, std::vector<MinMaxPST_Node>(batch));
+		for (auto& b : q) {
+			for (auto& o : b)
+				o = std::make_pair(gen() % n, gen() % 100);
+			std::sort(b.begin(), b.end());
+		}
+
+		size_t sumSingle = 0, sumBatched = 0;
+		const double single = timeIt(1, [&]() {
+			for (auto& b : q)
+				for (auto& o : b)
+					sumSingle += pst.enumerateUp(o.first, pst.getPosINF(), o.second).size();
+		});
+		const double batched = timeIt(1, [&]() {
+			for (auto& b : q)
+				for (auto& r : pst.enumerateUp(b))
+					sumBatched += r.size();
+		});
+		if (sumSingle != sumBatched)
+			std::cout << "ERROR: single and batched queries differ for " << n << " points" << std::endl;
+		std::cout << n << "\t" << single << "\t" << batched << "\t" << single / batched << std::endl;
+	}
+}
+
+// min-max PST vs. range tree (PST_LAYOUT_RANGE_TREE): build time, memory and query latency
+void benchmarkBackend(const std::vector<size_t>& sizes) {
+	std::mt19937 gen(42);
+	const size_t queries = 1000000;
+	std::cout << "points\tbackend\tbuild (ms)\tbytes/point\tleftmostNE (ns)\tleftmostSE (ns)\tenumerateUp (ns)" << std::endl;
+	for (auto n : sizes) {
+		std::vector<MinMaxPST_Node> points;
+		points.reserve(n);
+		for (auto p : randomPoints(n, gen))
+			points.push_back( MinMaxPST_Node(p) );
+		std::vector<MinMaxPST_Node> q(queries);
+		for (auto& o : q)
+			o = std::make_pair(gen() % n, gen() % n);
+		const coord_t inf = std::numeric_limits<coord_t>::max();
+
+		std::unique_ptr<MinMaxPST> pst;
+		const double pstBuild = timeIt(1, [&]() { pst.reset( new MinMaxPST(points, sizeof(uint32_t)) ); });
+		std::unique_ptr<MinMaxPST> tree;
+		const double treeBuild = timeIt(1, [&]() { tree.reset( new MinMaxPST(points, sizeof(uint32_t), PST_LAYOUT_RANGE_TREE) ); });
+
+		size_t sum[2][3] = { {0,0,0}, {0,0,0} };
+		// about 50 points per enumeration, as for the nodes of one mass below a trie node
+		const double pstNE = timeIt(1, [&]() { for (auto& o : q) sum[0][0] += pst->leftmostNE(o).first; });
+		const double pstSE = timeIt(1, [&]() { for (auto& o : q) sum[0][1] += pst->leftmostSE(o).first; });
+		const double pstEnum = timeIt(1, [&]() { for (auto& o : q) sum[0][2] += pst->enumerateUp(o.first, inf, o.second % 100).size(); });
+		const double treeNE = timeIt(1, [&]() { for (auto& o : q) sum[1][0] += tree->leftmostNE(o).first; });
+		const double treeSE = timeIt(1, [&]() { for (auto& o : q) sum[1][1] += tree->leftmostSE(o).first; });
+		const double treeEnum = timeIt(1, [&]() { for (auto& o : q) sum[1][2] += tree->enumerateUp(o.first, inf, o.second % 100).size(); });
+		if (sum[0][0] != sum[1][0] || sum[0][1] != sum[1][1] || sum[0][2] != sum[1][2])
+			std::cout << "ERROR: min-max PST and range tree differ for " << n << " points" << std::endl;
+
+		std::cout << n << "\tMinMaxPST\t" << pstBuild << "\t" << double(MinMaxPST::arraySize(n, PST_LAYOUT_HEAP) * 2 * sizeof(uint32_t)) / n << "\t"
+				  << 1e6 * pstNE / queries << "\t" << 1e6 * pstSE / queries << "\t" << 1e6 * pstEnum / queries << std::endl;
+		std::cout << n << "\tRangeTree\t" << treeBuild << "\t" << double(MinMaxPST::arraySize(n, PST_LAYOUT_RANGE_TREE) * 2 * sizeof(uint32_t)) / n << "\t"
+				  << 1e6 * treeNE / queries << "\t" << 1e6 * treeSE / queries << "\t" << 1e6 * treeEnum / queries << std::endl;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		std::cout << "USAGE: " << argv[0] << " build|layout|batch|backend [<nr of points> ...]" << std::endl;
+		return 1;
+	}
+	const std::string mode = argv[1];
+	std::vector<size_t> sizes;
+	for (int i = 2; i < argc; i++)
+		sizes.push_back( strtoull(argv[i], nullptr, 10) );
+
+	if (mode == "build") {
+		if (sizes.empty())
+			sizes = { 1000, 10000, 100000, 1000000 };
+		benchmarkBuild(sizes);
+	} else if (mode == "layout") {
+		if (sizes.empty())
+			sizes = { 10000, 1000000, 10000000 };
+		benchmarkLayout(sizes);
+	} else if (mode == "batch") {
+		if (sizes.empty())
+			sizes = { 10000, 1000000, 10000000 };
+		benchmarkBatch(sizes);
+	} else if (mode == "backend") {
+		if (sizes.empty())
+			sizes = { 10000, 1000000, 10000000 };
+		benchmarkBackend(sizes);
+	} else {
+		std::cout << "ERROR: unknown benchmark " << mode << std::endl;
+		return 1;
+	}
+	return 0;
+}
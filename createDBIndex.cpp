@@ -6,12 +6,15 @@
 #include <map>
 #include <stack>
 #include <fstream>
+#include <algorithm>
 
 #include "src/config.h"
 #include "src/trie.h"
 #include "src/helpers.h"
 #include "src/minmaxpst.h"
 #include "src/fastaReader.h"
+#include "src/indexFile.h"
+#include "src/parallel.h"
 
 #define DEBUG
 #ifdef DEBUG
@@ -27,7 +30,7 @@ int main(int argc, char *argv[]) {
 	std::string aaFile;
 
 	if (argc < 2) {
-		std::cout << "USAGE: " << argv[0] << " <DB File (fasta)> [<post-translation    al modifications file (cfg/modifications.cfg)> <AA masses file (cfg/aminoacids.cfg)    >]" << std::endl;
+		std::cout << "USAGE: " << argv[0] << " <DB File (fasta)> [<post-translation    al modifications file (cfg/modifications.cfg)> <AA masses file (cfg/aminoacids.cfg)    > <nr of threads (all cores)> <PST layout: heap|blocked|rangetree (heap)>]" << std::endl;
 		return 1;
 	} else
 		dbFile = argv[1];
@@ -39,42 +42,94 @@ int main(int argc, char *argv[]) {
 		aaFile = argv[3];
 	else
 		aaFile = "cfg/aminoacids.cfg";
+	size_t nrThreads = defaultThreads();
+	if (argc > 4)
+		nrThreads = std::max(1, atoi(argv[4]));
+	PSTLayout layout = PST_LAYOUT_HEAP;
+	if (argc > 5) {
+		if (std::string(argv[5]) == "blocked")
+			layout = PST_LAYOUT_BLOCKED;
+		else if (std::string(argv[5]) == "rangetree")
+			layout = PST_LAYOUT_RANGE_TREE;
+		else if (std::string(argv[5]) != "heap") {
+			std::cout << "ERROR: unknown PST layout " << argv[5] << " (heap, blocked or rangetree)" << std::endl;
+			return 1;
+		}
+	}
 	LOG("Program: " + std::string(argv[0]));
 	LOG("DB File: " + dbFile);
 	LOG("PTM File: " + modFile);
 	LOG("AAmasses File: " + aaFile);
+	LOG("Threads: " + std::to_string(nrThreads));
+	LOG("PST layout: " + std::string(layout == PST_LAYOUT_BLOCKED ? "blocked" : (layout == PST_LAYOUT_RANGE_TREE ? "rangetree" : "heap")));
 	cfg::loadConfig(aaFile,modFile);
 
-	// read fasta file
+	// read fasta file and build the trie from the sorted suffixes of the indexed part of each protein
 	FastaReader f(dbFile);
-	std::vector<std::pair<std::array<std::string,2>,size_t>> res;
-	size_t dbsize = f.getPeptides(30,res);
+	Trie t(nrThreads);
+	std::string text;
+	std::vector< std::array<size_t,2> > ranges;
+	size_t dbsize = f.forEachProtein([&ranges](const std::string& protein, const std::string& seq, size_t pos) {
+			const std::array<size_t,2> range = {{ pos, FastaReader::getIndexedLength(seq.size(), 30) }};
+			ranges.push_back(range);
+		}, text);
+	t.addSuffixes(text, ranges, 30);
+	ranges.clear();
 	std::cout << "DB size: " << dbsize << std::endl;
-	
-	Trie t;
-	for (auto pep : res)
-		t.add(pep.first[1],pep.first[0]);
-	res.clear();
-	res.shrink_to_fit();
 	std::cout << "Trie construction done" << std::endl;
 
-	std::map< size_t, std::vector< MinMaxPST_Node > > points;
-	t.getNodesByMass(points);
+	std::vector<size_t> masses;
+	std::vector<size_t> offsets;
+	std::vector< MinMaxPST_Node > points;
+	t.getNodesByMass(masses, offsets, points);
 	std::cout << "points sorted by mass" << std::endl;
 	
-	std::ofstream outFile;
-	outFile.open(dbFile + ".db");
+	// narrowest coordinate width for preorder and postorder numbers
+	const size_t width = MinMaxPST::narrowestWidth(t.size());
+	LOG("coordinate width: " + std::to_string(8*width) + " bit");
+	IndexWriter outFile(dbFile + ".db", t.size(), width, layout);
+	if (!outFile.good())
+		return 1;
 
-	for ( auto m : points )
-		outFile << m.first << ":" << MinMaxPST(m.second) << std::endl;
-	points.clear();
+	// build the PSTs of a batch of masses in parallel, then write them in order of mass
+	const size_t BATCH_SIZE = 1 << 20;	// points per batch
+	for ( size_t i = 0; i < masses.size(); ) {
+		size_t j = i+1;
+		while ( j < masses.size() && offsets[j+1] - offsets[i] <= BATCH_SIZE )
+			j++;
+		std::vector<MinMaxPST> psts(j-i);
+		parallelFor(j-i, [&](size_t k) {
+				psts[k] = MinMaxPST(points.data() + offsets[i+k], points.data() + offsets[i+k+1], width, layout);
+			}, nrThreads);
+		for ( size_t k = 0; k < psts.size(); k++ )
+			outFile.addPST(masses[i+k], psts[k]);
+		i = j;
+	}
+	std::vector< MinMaxPST_Node >().swap(points);
 
 	std::cout << "PSTs written" << std::endl;
 
-	outFile << "LEAVES:" << MinMaxPST( t.getLeaves() ) << std::endl;
+	outFile.writeLeaves( MinMaxPST( t.getLeaves(), width, layout ) );
 	std::cout << "Leaves PST written" << std::endl;
 
-	outFile << "TRIE:" << t << std::endl;
+	outFile.writeTrie( t.getTrieTable(width) );
+	outFile.writeLeafSeqs( t.getLeafTable(text) );
+	text.clear();
+#ifdef MOD_TOLERANT
+	std::vector<char> order;
+	std::vector<size_t> lastOcc;
+	outFile.writeLastOcc( order, t.getLastOccTable(order, lastOcc) );
+	lastOcc.clear();
+	LOG("LastOcc annotation written");
+#endif
+#ifdef MUT_TOLERANT
+	std::unordered_map< size_t, std::vector<size_t> > linkMap;
+	const LinkTable links( t.computeLinks(linkMap), t.size() );
+	linkMap.clear();
+	outFile.writeLinks( links.getOffsets(), links.getLinks() );
+	LOG("Links written");
+#endif
+	outFile.close();
 	std::cout << "Trie structure written" << std::endl;
 	std::cout << "done" << std::endl;
 }
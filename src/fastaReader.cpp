@@ -22,39 +22,83 @@
 
 FastaReader::FastaReader(std::string f) : filename(f) {};
 FastaReader::~FastaReader(){};
-void split(const std::string& name, const std::string& seq, const size_t maxLength, std::vector<std::pair<std::array<std::string,2>,size_t>>& res) {
+// true if the masses of all amino acids of seq are known
+bool isKnown(const std::string& name, const std::string& seq) {
 	for (auto s : seq) {
 		if (cfg::AAmasses.find(s) == cfg::AAmasses.end()) {
 			LOG("ERROR: Mass of amino acid " + std::string(1,s) +  " unknown. Ignoring protein " + name + ".");
-			return;
+			return false;
 		}
 	}
+	return true;
+}
+
+// pass substrings of seq to handler, positions are shifted by offset
+void split(const std::string& name, const std::string& seq, const size_t maxLength, const PeptideHandler& handler, const size_t offset = 0) {
 	if (seq.size() < maxLength) {
-		for (auto it = seq.begin(); it < seq.end(); it++) {
-			std::array<std::string,2> id = { name, std::string(it,seq.end()) };
-			res.push_back( std::make_pair( id, std::distance(seq.begin(), seq.end()) ) );
-		}
-		return;
+		for (auto it = seq.begin(); it < seq.end(); it++)
+			handler( name, std::string(it,seq.end()), offset + std::distance(seq.begin(), seq.end()) );
 	} else {
 		auto start = seq.begin();
 		auto end = seq.begin() + maxLength;
 		while (end != seq.end()) {
-			std::array<std::string,2> id = { name, std::string(start,end) };
-			res.push_back( std::make_pair(id, std::distance(seq.begin(), end)) );
+			handler( name, std::string(start,end), offset + std::distance(seq.begin(), end) );
 			start++;
 			end++;
 		}
 		end--;
 		while (start != end) {
-			std::array<std::string,2> id = { name, std::string(start,end) };
-			res.push_back( std::make_pair(id, std::distance(seq.begin(), end)) );
+			handler( name, std::string(start,end), offset + std::distance(seq.begin(), end) );
 			start++;
 		}
 	}
 }
 
+size_t FastaReader::getIndexedLength(const size_t length, const size_t maxLength) {
+	// the last char of proteins with at least maxLength chars is not part of any substring (see split)
+	return (length < maxLength) ? length : length - 1;
+}
+
 size_t FastaReader::getPeptides(const size_t maxLength, std::vector<std::pair<std::array<std::string,2>,size_t>>& res) const {
-	// res entry meaning: <protein ID, substring>, pos of last char
+	const PeptideHandler collect = [&res](const std::string& name, const std::string& pep, size_t pos) {
+			std::array<std::string,2> id = { name, pep };
+			res.push_back( std::make_pair(id, pos) );
+		};
+	return readProteins([&](const std::string& name, const std::string& seq, size_t offset) {
+			split(name, seq, maxLength, collect, offset);
+		}, nullptr);
+}
+
+size_t FastaReader::getPeptides(const size_t maxLength, std::vector<std::pair<std::array<std::string,2>,size_t>>& res, std::string& text) const {
+	const PeptideHandler collect = [&res](const std::string& name, const std::string& pep, size_t pos) {
+			std::array<std::string,2> id = { name, pep };
+			res.push_back( std::make_pair(id, pos) );
+		};
+	return forEachPeptide(maxLength, collect, text);
+}
+
+size_t FastaReader::forEachPeptide(const size_t maxLength, const PeptideHandler& handler, std::string& text) const {
+	return readProteins([&](const std::string& name, const std::string& seq, size_t offset) {
+			split(name, seq, maxLength, handler, offset);
+		}, &text);
+}
+
+size_t FastaReader::forEachProtein(const ProteinHandler& handler, std::string& text) const {
+	return readProteins(handler, &text);
+}
+
+// append seq to text (if given) and pass it to handler, unless it contains unknown amino acids
+void addProtein(const std::string& name, const std::string& seq, const ProteinHandler& handler, std::string* text) {
+	if (!isKnown(name, seq))
+		return;
+	const size_t offset = (text == nullptr) ? 0 : text->size();
+	if (text != nullptr)
+		*text += seq;
+	handler(name, seq, offset);
+}
+
+size_t FastaReader::readProteins(const ProteinHandler& handler, std::string* text) const {
+	// handler arguments: protein ID, sequence, position in text
 	size_t dbsize = 0;
 	std::ifstream infile(filename);
 	if (!infile.good()) {
@@ -69,7 +113,7 @@ size_t FastaReader::getPeptides(const size_t maxLength, std::vector<std::pair<st
 		if (line[0] == '>') {
 			// process last protein sequence
 			if (proteinName.size() > 0)
-				split(proteinName, proteinSequence, maxLength, res);
+				addProtein(proteinName, proteinSequence, handler, text);
 			// read next protein identifier
 			proteinName = line.substr(1);
 			dbsize += proteinSequence.size();
@@ -78,8 +122,8 @@ size_t FastaReader::getPeptides(const size_t maxLength, std::vector<std::pair<st
 			proteinSequence += line;
 	}
 	if (proteinName.size() > 0) {
-		split(proteinName, proteinSequence, maxLength, res);
+		addProtein(proteinName, proteinSequence, handler, text);
 		dbsize += proteinSequence.size();
 	}
 	return dbsize;
-};
+}
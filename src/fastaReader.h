@@ -7,16 +7,32 @@
 
 #include <string>
 #include <array>
+#include <vector>
+#include <functional>
+
+// called for each substring with protein ID, substring, position of last char
+typedef std::function<void(const std::string&, const std::string&, size_t)> PeptideHandler;
+// called for each indexed protein with protein ID, sequence, position of the sequence in the protein text
+typedef std::function<void(const std::string&, const std::string&, size_t)> ProteinHandler;
 
 class FastaReader { 
 	private:
 		const std::string filename;
-		
+		size_t readProteins(const ProteinHandler& handler, std::string* text) const;
+
 	public:
 		FastaReader(std::string f);
 		~FastaReader();
 		// push substrings of f to res (<protein ID, substring>, position of last char) and return size of db
 		size_t getPeptides(const size_t maxLength, std::vector<std::pair<std::array<std::string,2>,size_t>>& res) const; 
+		// as above, but append the sequences of all indexed proteins to text; positions are relative to text
+		size_t getPeptides(const size_t maxLength, std::vector<std::pair<std::array<std::string,2>,size_t>>& res, std::string& text) const; 
+		// as above, but pass the substrings to handler one protein at a time instead of collecting them
+		size_t forEachPeptide(const size_t maxLength, const PeptideHandler& handler, std::string& text) const;
+		// append the sequences of all indexed proteins to text and pass each of them to handler
+		size_t forEachProtein(const ProteinHandler& handler, std::string& text) const;
+		// length of the prefix of a protein whose substrings are indexed (the substrings of length <= maxLength of this prefix)
+		static size_t getIndexedLength(const size_t length, const size_t maxLength);
 };
 
 #endif
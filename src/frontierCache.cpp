@@ -0,0 +1,77 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "frontierCache.h"
+
+//#define DEBUG
+#ifdef DEBUG
+#	define LOG(x) std::clog << "DEBUG: " << x << std::endl;
+#else
+#	define LOG(x) do {} while (0)
+#endif
+
+
+FrontierCache::FrontierCache(size_t c) : capacity(c), nodes(0), hits(0), misses(0) {}
+
+std::shared_ptr<const FrontierCache::Frontier> FrontierCache::longest(const std::vector<size_t>& masses, size_t minLength, size_t maxLength, size_t& length) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<size_t> key(masses.begin(), masses.begin() + std::min(maxLength, masses.size()));
+	for (; key.size() >= std::max<size_t>(minLength, 1); key.pop_back()) {
+		auto it = index.find(key);
+		if (it == index.end())
+			continue;
+		entries.splice(entries.begin(), entries, it->second);
+		hits++;
+		length = key.size();
+		return it->second->second;
+	}
+	misses++;
+	length = 0;
+	return nullptr;
+}
+
+void FrontierCache::put(const std::vector<size_t>& masses, size_t length, const Frontier& frontier) {
+	// a single entry may not take more than an eighth of the cache
+	if (8 * frontier.size() > capacity)
+		return;
+	std::vector<size_t> key(masses.begin(), masses.begin() + length);
+	std::lock_guard<std::mutex> lock(mutex);
+	if (index.count(key) > 0)
+		return;
+	entries.push_front( Entry(key, std::make_shared<const Frontier>(frontier)) );
+	index[key] = entries.begin();
+	// an entry counts one node more than it holds, so that empty frontiers are dropped as well
+	nodes += frontier.size() + 1;
+	while (nodes > capacity) {
+		nodes -= entries.back().second->size() + 1;
+		index.erase(entries.back().first);
+		entries.pop_back();
+	}
+}
+
+size_t FrontierCache::size() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+size_t FrontierCache::getNodes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return nodes;
+}
+
+size_t FrontierCache::getHits() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return hits;
+}
+
+size_t FrontierCache::getMisses() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return misses;
+}
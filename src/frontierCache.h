@@ -0,0 +1,44 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef FRONTIERCACHE_H
+#define FRONTIERCACHE_H
+
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "minmaxpst.h"
+
+// nodes matched by the leading blocks of block patterns, keyed by the prefix masses of the blocks and
+// shared by the query threads; the least recently used entries are dropped once the entries hold more
+// than capacity nodes together
+class FrontierCache {
+	public:
+		typedef std::vector< MinMaxPST_Node > Frontier;	// in preorder
+
+	private:
+		typedef std::pair< std::vector<size_t>, std::shared_ptr<const Frontier> > Entry;
+		std::list<Entry> entries;		// most recently used first
+		std::map< std::vector<size_t>, std::list<Entry>::iterator > index;
+		size_t capacity;
+		size_t nodes;					// of all entries, plus one per entry
+		size_t hits;
+		size_t misses;
+		mutable std::mutex mutex;
+
+	public:
+		FrontierCache(size_t capacity);
+		// entry of the longest prefix masses[0..length) with minLength <= length <= maxLength, nullptr if there is none
+		std::shared_ptr<const Frontier> longest(const std::vector<size_t>& masses, size_t minLength, size_t maxLength, size_t& length);
+		void put(const std::vector<size_t>& masses, size_t length, const Frontier& frontier); // nodes matched by masses[0..length)
+		size_t size() const; // nr of entries
+		size_t getNodes() const;
+		size_t getHits() const;
+		size_t getMisses() const;
+};
+
+#endif
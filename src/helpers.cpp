@@ -11,11 +11,13 @@
 #include <fstream>
 #include <sstream>
 #include <limits>
+#include <cstdlib>
 #include <assert.h>
 #include <algorithm>
 
 #include "config.h"
 #include "minmaxpst.h"
+#include "indexFile.h"
 #include "helpers.h"
 
 //#define DEBUG
@@ -35,6 +37,125 @@ size_t getMass( const std::string& seq) {
 	return mass;
 }
 
+/*
+ * LeafTable class implementation
+ */
+
+LeafTable::LeafTable() {}
+
+LeafTable::LeafTable(const SharedArray<LeafEntry>& d, const SharedArray<char>& t) : dir(d), text(t) {}
+
+LeafTable::LeafTable(const std::map<size_t,std::string>& leafSeqs) {
+	std::vector<LeafEntry> d;
+	std::vector<char> t;
+	d.reserve(leafSeqs.size());
+	for ( auto l : leafSeqs ) {
+		LeafEntry e = { l.first, t.size(), l.second.size() };
+		d.push_back(e);
+		t.insert(t.end(), l.second.begin(), l.second.end());
+	}
+	dir = SharedArray<LeafEntry>( std::move(d) );
+	text = SharedArray<char>( std::move(t) );
+}
+
+const LeafEntry& LeafTable::find(size_t preorder) const {
+	const LeafEntry* it = std::lower_bound( dir.begin(), dir.end(), preorder,
+			[](const LeafEntry& e, size_t p) { return e.preorder < p; } );
+	assert( it != dir.end() && it->preorder == preorder );
+	return *it;
+}
+
+bool LeafTable::contains(size_t preorder) const {
+	const LeafEntry* it = std::lower_bound( dir.begin(), dir.end(), preorder,
+			[](const LeafEntry& e, size_t p) { return e.preorder < p; } );
+	return it != dir.end() && it->preorder == preorder;
+}
+
+size_t LeafTable::size() const { return dir.size(); }
+size_t LeafTable::length(size_t preorder) const { return find(preorder).length; }
+
+size_t LeafTable::count(size_t first, size_t last) const {
+	auto less = [](const LeafEntry& e, size_t p) { return e.preorder < p; };
+	return std::lower_bound( dir.begin(), dir.end(), last, less ) - std::lower_bound( dir.begin(), dir.end(), first, less );
+}
+
+std::string LeafTable::at(size_t preorder) const {
+	const LeafEntry& e = find(preorder);
+	return std::string( text.data() + e.offset, e.length );
+}
+
+std::string LeafTable::at(size_t preorder, size_t length) const {
+	const LeafEntry& e = find(preorder);
+	assert( length <= e.length );
+	return std::string( text.data() + e.offset, length );
+}
+
+const SharedArray<LeafEntry>& LeafTable::getDir() const { return dir; }
+const SharedArray<char>& LeafTable::getText() const { return text; }
+
+
+/*
+ * TrieTable class implementation
+ */
+
+TrieTable::TrieTable() : width(sizeof(size_t)) {}
+
+TrieTable::TrieTable(const std::vector< std::pair<size_t,size_t> >& trie, size_t w) : width(w) {
+	if (width == sizeof(uint32_t)) {
+		std::vector<uint32_t> t;
+		t.reserve(2*trie.size());
+		for ( auto n : trie ) {
+			assert( n.first <= std::numeric_limits<uint32_t>::max() && n.second <= std::numeric_limits<uint32_t>::max() );
+			t.push_back(n.first);
+			t.push_back(n.second);
+		}
+		t32 = SharedArray<uint32_t>( std::move(t) );
+	} else {
+		std::vector<uint64_t> t;
+		t.reserve(2*trie.size());
+		for ( auto n : trie ) {
+			t.push_back(n.first);
+			t.push_back(n.second);
+		}
+		t64 = SharedArray<uint64_t>( std::move(t) );
+	}
+}
+
+TrieTable::TrieTable(const void* data, size_t size, size_t w, std::shared_ptr<const void> storage) : width(w) {
+	if (width == sizeof(uint32_t))
+		t32 = SharedArray<uint32_t>( static_cast<const uint32_t*>(data), 2*size, storage );
+	else
+		t64 = SharedArray<uint64_t>( static_cast<const uint64_t*>(data), 2*size, storage );
+}
+
+TrieTable::TrieTable(const SharedArray<uint32_t>& t) : t32(t), width(sizeof(uint32_t)) {}
+TrieTable::TrieTable(const SharedArray<uint64_t>& t) : t64(t), width(sizeof(uint64_t)) {}
+
+std::pair<size_t,size_t> TrieTable::at(size_t preorder) const {
+	assert( preorder < size() );
+	if (width == sizeof(uint32_t))
+		return std::make_pair( t32[2*preorder], t32[2*preorder+1] );
+	return std::make_pair( t64[2*preorder], t64[2*preorder+1] );
+}
+
+size_t TrieTable::size() const { return (width == sizeof(uint32_t)) ? t32.size()/2 : t64.size()/2; }
+size_t TrieTable::getWidth() const { return width; }
+
+size_t TrieTable::depth(size_t preorder) const {
+	size_t d = 0;
+	for (; preorder > 0; d++)
+		preorder = at(preorder).second;
+	return d;
+}
+
+// the nodes before v in preorder are its ancestors and the nodes left of it, those before v in postorder
+// are its descendants and the nodes left of it, so postorder - preorder = size - 1 - depth
+size_t TrieTable::subtreeSize(size_t preorder) const {
+	return at(preorder).first + depth(preorder) + 1 - preorder;
+}
+const void* TrieTable::data() const { return (width == sizeof(uint32_t)) ? static_cast<const void*>(t32.data()) : static_cast<const void*>(t64.data()); }
+
+
 bool exploreDown( std::vector< MinMaxPST_Node >& curPath, const MinMaxPST& pst ) {
 	MinMaxPST_Node nextPoint = pst.leftmostSE( curPath.back() );
 	if ( 
@@ -64,11 +185,80 @@ bool exploreRight( std::vector< MinMaxPST_Node >& curPath, const MinMaxPST& pst
 		return false;
 }
 
-std::vector<size_t> findBP( std::vector< size_t >& bp, const std::map< size_t, MinMaxPST >& psts ) {
-	// curPath stores the currently explored path. The mass of a vertex curPath[i] is masses[i];
-	// we first explore the path downwards at curPath.back(); if no successor, explore to the right (siblings)
-	std::vector<size_t> res;
-	if (bp.size() == 0) return res;
+// drop the nodes below an earlier node of the list (in preorder). The mass of a trie path repeats below
+// characters of mass 0 (X, * and - in cfg/aminoacids.cfg), and only the topmost node of a mass on a path
+// is matched, so the nodes of a mass that remain are not nested
+void keepTopmost( std::vector< MinMaxPST_Node >& nodes ) {
+	size_t k = 0;
+	for (size_t i = 0; i < nodes.size(); i++)
+		if (k == 0 || nodes[i].second > nodes[k-1].second)
+			nodes[k++] = nodes[i];
+	nodes.resize(k);
+}
+
+// topmost nodes of mass masses[d] below the node v at depth d-1 (the root for d = 0), in preorder;
+// the nodes of the mass below v are the points of the PST of masses[d] in the quadrant x >= v.pre, y <= v.post
+std::vector< MinMaxPST_Node > getChildren( const MinMaxPST_Node& v, const MinMaxPST& pst ) {
+	std::vector< MinMaxPST_Node > res = pst.enumerateUp( v.first, pst.getPosINF(), v.second );
+	keepTopmost(res);
+	return res;
+}
+
+// relative cost of checking a node for an ancestor of some mass (a PST query) and of enumerating it
+#ifndef PLAN_ANCESTOR_COST
+#define PLAN_ANCESTOR_COST 4
+#endif
+
+// nr of nodes matched by all but the last block whose children of the last mass are queried at once
+#ifndef MATCH_SLICE
+#define MATCH_SLICE 256
+#endif
+
+// block to start the search of a pattern with the PSTs pst of its prefix masses: the nodes of the mass
+// of block a are enumerated and checked for ancestors of the masses of the blocks before a, which costs
+// about |pst[a]| * (1 + a * PLAN_ANCESTOR_COST), and the search continues from them to the last block
+size_t planAnchor( const std::vector< const MinMaxPST* >& pst ) {
+	size_t anchor = 0;
+	for (size_t a = 1; a < pst.size(); a++)
+		if (pst[a]->size() * (1 + a * PLAN_ANCESTOR_COST) < pst[anchor]->size() * (1 + anchor * PLAN_ANCESTOR_COST))
+			anchor = a;
+	return anchor;
+}
+
+// true if v has an ancestor in each of pst[0..a); the ancestors of v are the points to its upper left,
+// and masses increase along a path, so there is at most one per PST
+bool hasAncestors( const MinMaxPST_Node& v, const std::vector< const MinMaxPST* >& pst, size_t a ) {
+	for (size_t d = a; d > 0; d--) {
+		const MinMaxPST_Node u = pst[d-1]->rightmostNW(v);
+		if (u.first == pst[d-1]->getNegINF() && u.second == pst[d-1]->getPosINF())
+			return false;
+	}
+	return true;
+}
+
+// pass the topmost children of the candidates (not nested, in preorder) in pst to visit, in preorder; they are
+// queried for MATCH_SLICE candidates at a time, so that they are never all in memory. Returns false if visit
+// stopped the search
+bool visitChildren( const std::vector< MinMaxPST_Node >& candidates, const MinMaxPST& pst, const MatchVisitor& visit ) {
+	std::vector< MinMaxPST_Node > slice;
+	for (size_t i = 0; i < candidates.size(); i += MATCH_SLICE) {
+		slice.assign(candidates.begin() + i, candidates.begin() + std::min(candidates.size(), i + MATCH_SLICE));
+		for (auto& children : pst.enumerateUp(slice)) {
+			keepTopmost(children);
+			for (auto& v : children)
+				if (!visit(v.first))
+					return false;
+		}
+	}
+	return true;
+}
+
+void findBP( std::vector< size_t >& bp, const MassDirectory& psts, const MatchVisitor& visit, FrontierCache* cache ) {
+	// candidates stores the nodes of mass masses[d] on the paths matched so far, in preorder;
+	// the nodes of the next mass below all of them are found in one batched PST query.
+	// The search starts at the longest prefix of the masses in the cache, or else at the block planAnchor
+	// chooses, with the nodes of its mass that match the blocks before it
+	if (bp.size() == 0) return;
 
 	std::vector<size_t> masses;
 	masses.reserve(bp.size());
@@ -76,38 +266,291 @@ std::vector<size_t> findBP( std::vector< size_t >& bp, const std::map< size_t, M
 	for (size_t i = 1; i < bp.size(); i++)
 		masses.push_back(masses.back()+bp.at(i));
 
-	std::vector< MinMaxPST_Node > curPath;
-	curPath.push_back(std::make_pair(0,psts.begin()->second.getPosINF()));
-	MinMaxPST_Node queryPoint, nextPoint;
+	// patterns with a prefix mass without nodes are rejected before any PST is read
+	for (auto m : masses)
+		if (!psts.contains(m))
+			return;
+	std::vector< const MinMaxPST* > pst(masses.size());
+	for (size_t d = 0; d < masses.size(); d++)
+		pst[d] = psts.find( masses[d] );
+
+	std::vector< MinMaxPST_Node > candidates;
+	size_t known = 0;	// nr of blocks the candidates match
+	std::shared_ptr<const FrontierCache::Frontier> cached;
+	if (cache != nullptr)
+		cached = cache->longest(masses, 1, masses.size(), known);
+	if (cached)
+		candidates = *cached;
+	else {
+		const size_t anchor = planAnchor(pst);
+		for (auto& v : getChildren( std::make_pair(0,psts.getPST(0).getPosINF()), *pst[anchor] ))
+			if (hasAncestors(v, pst, anchor))
+				candidates.push_back(v);
+		known = anchor+1;
+		if (cache != nullptr)
+			cache->put(masses, known, candidates);
+	}
+	if (known == masses.size()) {
+		for (auto& v : candidates)
+			if (!visit(v.first))
+				return;
+		return;
+	}
+	for (size_t d = known; d+1 < masses.size() && !candidates.empty(); d++) {
+		// keepTopmost leaves no nested candidates, so the children of each one follow those of its predecessors
+		// in preorder and are reported once
+		std::vector< MinMaxPST_Node > next;
+		for (auto& children : pst[d]->enumerateUp(candidates)) {
+			keepTopmost(children);
+			next.insert(next.end(), children.begin(), children.end());
+		}
+		candidates.swap(next);
+		if (cache != nullptr)
+			cache->put(masses, d+1, candidates);
+	}
+	visitChildren(candidates, *pst.back(), visit);
+}
 
-	bool state = true; // state is true if we have to exploreDown from curPath.back() and otherwise false
-	do {
-		queryPoint = curPath.back();
-		if (curPath.size() == masses.size()+1) {
-			res.push_back(curPath.back().first);
-			//curPath.pop_back();
-			state = exploreRight( curPath, psts.find( masses[curPath.size()-2] )->second );
+std::vector<size_t> findBP( std::vector< size_t >& bp, const MassDirectory& psts ) {
+	std::vector<size_t> res;
+	findBP(bp, psts, [&res](size_t v) { res.push_back(v); return true; });
+	return res;
+}
 
-		} else {
-			if ( psts.find( masses[curPath.size()-1] ) == psts.end() ) {
-				curPath.pop_back();
-				state = false;
-			} else {
-				if ( state ) {
-					state = exploreDown( curPath, psts.find( masses[curPath.size()-1] )->second );
-				}
-				if ( !state ) {
-					if (curPath.size() == 1) // no exploreRight at root
-						curPath.pop_back();
-					else 
-						state = exploreRight( curPath, psts.find( masses[curPath.size()-2] )->second );
-				}
-			}
+size_t countLeaves( size_t preorder, const TrieTable& trie, const LeafTable& leafSeqs ) {
+	// the subtree is the preorder range [preorder, preorder + size)
+	return leafSeqs.count( preorder, preorder + trie.subtreeSize(preorder) );
+}
+
+MatchCount countBP( std::vector< size_t >& bp, const MassDirectory& psts, const TrieTable& trie, const LeafTable& leafSeqs ) {
+	MatchCount res = { 0, 0 };
+	findBP(bp, psts, [&](size_t v) {
+			res.matches++;
+			res.leaves += countLeaves(v, trie, leafSeqs);
+			return true;
+		});
+	return res;
+}
+
+size_t MassTolerance::at(size_t mass) const { return absolute + mass / 1000000 * ppm + mass % 1000000 * ppm / 1000000; }
+bool MassTolerance::exact() const { return absolute == 0 && ppm == 0; }
+
+bool readMassTolerance( const std::string& s, MassTolerance& tol ) {
+	tol.absolute = 0;
+	tol.ppm = 0;
+	const bool ppm = s.size() > 3 && s.compare(s.size()-3, 3, "ppm") == 0;
+	const std::string value = ppm ? s.substr(0, s.size()-3) : s;
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	(ppm ? tol.ppm : tol.absolute) = strtoull(value.c_str(), nullptr, 10);
+	return true;
+}
+
+// the nodes with a mass in [lo,hi] below the query points, in preorder; the query points are not nested
+std::vector< MinMaxPST_Node > getChildrenInWindow( const std::vector< MinMaxPST_Node >& queries, const MassDirectory& psts, size_t lo, size_t hi ) {
+	auto byPreorder = [](const MinMaxPST_Node& a, const MinMaxPST_Node& b) { return a.first < b.first; };
+	std::vector< MinMaxPST_Node > res;
+	for (size_t i = psts.lowerBound(lo); i < psts.size() && psts.getMass(i) <= hi; i++)
+		for (auto& children : psts.getPST(i).enumerateUp(queries)) {
+			// the windows of consecutive prefix masses can overlap, and a query point is in its own range (the
+			// root, of mass 0, in a window from 0); it is dropped after the nodes below it of its own mass
+			keepTopmost(children);
+			for (auto& v : children)
+				if (!std::binary_search(queries.begin(), queries.end(), v, byPreorder))
+					res.push_back(v);
 		}
-	} while (curPath.size() > 0);
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+void findBP( std::vector< size_t >& bp, const MassDirectory& psts, const MassTolerance& tol, const MatchVisitor& visit ) {
+	// candidates stores the nodes matched by the blocks so far, in preorder; the nodes of each mass in the
+	// window of the next prefix mass below them are found with one batched query on the PST of that mass
+	if (tol.exact()) {
+		findBP(bp, psts, visit);
+		return;
+	}
+	if (bp.size() == 0) return;
+
+	size_t mass = 0;
+	for (auto m : bp) {
+		mass += m;
+		if (!psts.containsRange(mass - std::min(mass, tol.at(mass)), mass + tol.at(mass)))
+			return;
+	}
+
+	std::vector< MinMaxPST_Node > candidates( 1, std::make_pair(0, std::numeric_limits<coord_t>::max()) );
+	mass = 0;
+	for (size_t d = 0; d < bp.size() && !candidates.empty(); d++) {
+		mass += bp[d];
+		const size_t lo = mass - std::min(mass, tol.at(mass));
+		const size_t hi = mass + tol.at(mass);
+		// a window wider than the smallest amino acid mass can contain a node and its descendants; the nodes
+		// below a nested candidate are below the candidate above it as well, so only the topmost ones are queried
+		keepTopmost(candidates);
+		if (d+1 < bp.size()) {
+			candidates = getChildrenInWindow(candidates, psts, lo, hi);
+			continue;
+		}
+		// the matches below MATCH_SLICE candidates at a time follow those of the candidates before them
+		// in preorder, and are passed on before the next ones are queried
+		std::vector< MinMaxPST_Node > slice;
+		for (size_t i = 0; i < candidates.size(); i += MATCH_SLICE) {
+			slice.assign(candidates.begin() + i, candidates.begin() + std::min(candidates.size(), i + MATCH_SLICE));
+			for (auto& v : getChildrenInWindow(slice, psts, lo, hi))
+				if (!visit(v.first))
+					return;
+		}
+	}
+}
+
+std::vector<size_t> findBP( std::vector< size_t >& bp, const MassDirectory& psts, const MassTolerance& tol ) {
+	std::vector<size_t> res;
+	findBP(bp, psts, tol, [&res](size_t v) { res.push_back(v); return true; });
+	return res;
+}
+
+std::vector< std::vector<size_t> > findBPBatch( const std::vector< std::vector<size_t> >& bps, const MassDirectory& psts ) {
+	return findBPBatch(bps, 0, bps.size(), psts);
+}
+
+std::vector< std::vector<size_t> > findBPBatch( const std::vector< std::vector<size_t> >& bps, size_t first, size_t last, const MassDirectory& psts, FrontierCache* cache ) {
+	std::vector< std::vector<size_t> > res(last - first);
+	findBPBatch(bps, first, last, psts, [&](size_t p, size_t v) { res[p-first].push_back(v); return true; }, cache);
 	return res;
 }
 
+void findBPBatch( const std::vector< std::vector<size_t> >& bps, size_t first, size_t last, const MassDirectory& psts, const BatchVisitor& visit, FrontierCache* cache ) {
+	// the patterns are searched in input order. In lexicographic order, the patterns with the same first d blocks
+	// form a run, and the nodes they match are kept at levels[s][d-1] for the first position s of the run until
+	// all patterns of the run are searched. Each pattern resumes from the longest of its leading
+	// blocks that are known there or in the cache; the last level is passed on as findBP does
+	struct Level {
+		size_t users;		// patterns of the run not searched yet
+		bool known;
+		std::vector< MinMaxPST_Node > nodes;
+	};
+	std::vector<size_t> masses;
+	std::vector< const MinMaxPST* > pst;
+	auto prefixMasses = [&](size_t p) -> bool {
+		masses.clear();
+		pst.clear();
+		for (auto m : bps[p]) {
+			masses.push_back( masses.empty() ? m : masses.back() + m );
+			if (!psts.contains(masses.back()))
+				return false;
+			pst.push_back( psts.find(masses.back()) );
+		}
+		return true;
+	};
+	// patterns that start better at a later block are searched on their own
+	std::vector<size_t> order;
+	std::vector<bool> alone(last - first, false);
+	for (size_t p = first; p < last; p++) {
+		if (bps[p].empty() || !prefixMasses(p))
+			continue;
+		if (planAnchor(pst) > 0)
+			alone[p-first] = true;
+		else
+			order.push_back(p);
+	}
+	std::sort(order.begin(), order.end(), [&bps](size_t a, size_t b) { return bps[a] < bps[b]; });
+	// the pattern at position j has lcp[j] blocks in common with the one before it and shared[j] with a neighbour;
+	// its run of d blocks starts at runStart[j][d-1] for d <= shared[j]
+	std::vector<size_t> lcp(order.size(), 0);
+	std::vector<size_t> shared(order.size(), 0);
+	std::vector<size_t> rank(last - first);
+	for (size_t j = 0; j < order.size(); j++) {
+		rank[order[j]-first] = j;
+		if (j == 0)
+			continue;
+		const std::vector<size_t>& a = bps[order[j-1]];
+		const std::vector<size_t>& b = bps[order[j]];
+		while (lcp[j] < a.size() && lcp[j] < b.size() && a[lcp[j]] == b[lcp[j]])
+			lcp[j]++;
+		shared[j-1] = std::max(shared[j-1], lcp[j]);
+		shared[j] = lcp[j];
+	}
+	std::vector< std::vector<size_t> > runStart(order.size());
+	std::vector< std::vector<Level> > levels(order.size());
+	for (size_t j = 0; j < order.size(); j++)
+		for (size_t d = 1; d <= shared[j]; d++) {
+			const size_t s = (lcp[j] >= d) ? runStart[j-1][d-1] : j;
+			runStart[j].push_back(s);
+			if (levels[s].size() < d)
+				levels[s].resize(d, Level{ 0, false, std::vector< MinMaxPST_Node >() });
+			levels[s][d-1].users++;
+		}
+
+	std::vector< MinMaxPST_Node > candidates;
+	for (size_t p = first; p < last; p++) {
+		if (bps[p].empty() || !prefixMasses(p))
+			continue;
+		const std::vector<size_t>& bp = bps[p];
+		if (alone[p-first]) {
+			std::vector<size_t> copy = bp;
+			findBP(copy, psts, [&](size_t v) { return visit(p, v); }, cache);
+			continue;
+		}
+		const size_t j = rank[p-first];
+		// the nodes matched by the longest leading blocks that are known (d of them)
+		size_t d = 0;
+		for (size_t k = shared[j]; k > 0; k--) {
+			const Level& level = levels[runStart[j][k-1]][k-1];
+			if (level.known) {
+				candidates = level.nodes;
+				d = k;
+				break;
+			}
+		}
+		size_t length = 0;
+		std::shared_ptr<const FrontierCache::Frontier> cached;
+		if (cache != nullptr && d < bp.size())
+			cached = cache->longest(masses, d+1, bp.size(), length);
+		if (cached) {
+			candidates = *cached;
+			d = length;
+		}
+		// the nodes matched by the first k blocks are kept for the later patterns of their run
+		auto keep = [&](size_t k) {
+			if (cache != nullptr)
+				cache->put(masses, k, candidates);
+			if (k > shared[j])
+				return;
+			Level& level = levels[runStart[j][k-1]][k-1];
+			if (level.users > 1) {
+				level.known = true;
+				level.nodes = candidates;
+			}
+		};
+		if (d == 0) {
+			candidates = getChildren( std::make_pair(0,psts.getPST(0).getPosINF()), *pst[0] );
+			keep(++d);
+		}
+		for (; d+1 < bp.size() && !candidates.empty(); d++) {
+			// keepTopmost leaves no nested candidates, so the children of each one follow those of its predecessors
+			std::vector< MinMaxPST_Node > next;
+			for (auto& children : pst[d]->enumerateUp(candidates)) {
+				keepTopmost(children);
+				next.insert(next.end(), children.begin(), children.end());
+			}
+			candidates.swap(next);
+			keep(d+1);
+		}
+		if (d+1 == bp.size())
+			visitChildren(candidates, *pst.back(), [&](size_t v) { return visit(p, v); });
+		else if (d == bp.size())	// all blocks known
+			for (auto& v : candidates)
+				if (!visit(p, v.first))
+					break;
+		for (size_t k = 1; k <= shared[j]; k++) {
+			Level& level = levels[runStart[j][k-1]][k-1];
+			if (--level.users == 0)
+				std::vector< MinMaxPST_Node >().swap(level.nodes);
+		}
+	}
+}
+
 std::vector<size_t> readIntArray(const std::string& s) {
 	std::string::size_type pos = s.find(':');
 	if (pos == std::string::npos)
@@ -170,7 +613,43 @@ void readBPFile( std::string file, std::vector<std::vector<size_t> >& bps ) {
 	}
 }
 
-void readDBFile( std::string file, std::map<size_t, MinMaxPST>& psts, MinMaxPST*& leaves, std::vector< std::pair<size_t,size_t> >& trie, std::map<size_t,std::string>& leafSeqs ) {
+// read binary index file (see indexFile.h)
+void readIndexFile( std::string file, MassDirectory& psts, MinMaxPST*& leaves, TrieTable& trie, LeafTable& leafSeqs ) {
+	IndexFile index(file);
+	if (!index.good())
+		return;
+
+	const size_t width = index.getCoordWidth();
+	const size_t nodeSize = 2*width;
+	const PSTLayout layout = index.getLayout();
+	size_t nrMasses, poolSize;
+	const MassEntry* masses = index.getSection<MassEntry>(SECTION_MASSES, nrMasses);
+	const char* pool = index.getSection<char>(SECTION_PSTS, poolSize);
+	for (size_t i = 0; i < nrMasses; i++) {
+		assert( (masses[i].offset + MinMaxPST::arraySize(masses[i].size, layout))*nodeSize <= poolSize );
+		psts.add( masses[i].mass, MinMaxPST( pool + masses[i].offset*nodeSize, masses[i].size, width, index.getStorage(), layout ) );
+	}
+
+	size_t n;
+	const char* l = index.getSection<char>(SECTION_LEAVES, n);
+	leaves = new MinMaxPST(l, MinMaxPST::sizeOfArray(n/nodeSize, layout), width, index.getStorage(), layout);
+
+	const char* t = index.getSection<char>(SECTION_TRIE, n);
+	trie = TrieTable(t, n/nodeSize, width, index.getStorage());
+
+	size_t textSize;
+	const LeafEntry* dir = index.getSection<LeafEntry>(SECTION_LEAFDIR, n);
+	const char* text = index.getSection<char>(SECTION_LEAFTEXT, textSize);
+	leafSeqs = LeafTable( SharedArray<LeafEntry>(dir, n, index.getStorage()), SharedArray<char>(text, textSize, index.getStorage()) );
+}
+
+void readDBFile( std::string file, MassDirectory& psts, MinMaxPST*& leaves, TrieTable& trie, LeafTable& leafSeqs ) {
+	if (IndexFile::isIndexFile(file)) {
+		readIndexFile(file, psts, leaves, trie, leafSeqs);
+		return;
+	}
+
+	// text format
 	std::ifstream db(file);
 
 	if (!db.good()) {
@@ -193,9 +672,7 @@ void readDBFile( std::string file, std::map<size_t, MinMaxPST>& psts, MinMaxPST*
 		std::stringstream sstream( line.substr(0,pos) );
 		sstream >> mass;
 
-		psts.insert(
-				std::make_pair(mass, MinMaxPST( line.substr(pos+1,line.size()))
-			));
+		psts.add( mass, MinMaxPST( line.substr(pos+1,line.size()) ) );
 	}
 
 	leaves = new MinMaxPST(line.substr(pos+1,line.size()));
@@ -205,7 +682,8 @@ void readDBFile( std::string file, std::map<size_t, MinMaxPST>& psts, MinMaxPST*
 	size_t size;
 	std::stringstream sstream( line.substr(5,line.size()) );
 	sstream >> size;
-	trie.resize( size );
+	std::vector< std::pair<size_t,size_t> > order( size );
+	std::map<size_t,std::string> seqs;
 	size_t pre, post, parent_pre;
 	std::string::size_type pos2,pos3,pos4;
 	while(std::getline(db, line)) {
@@ -225,74 +703,85 @@ void readDBFile( std::string file, std::map<size_t, MinMaxPST>& psts, MinMaxPST*
 		std::stringstream s3(line.substr(pos2+1,pos3-pos2-1));
 		s3 >> parent_pre;
 
-		trie.at(pre) = std::make_pair(post,parent_pre);
+		order.at(pre) = std::make_pair(post,parent_pre);
 
 		pos4 = line.find(',',pos3+1);
 		if (pos4-pos3 > 1)
-			leafSeqs.insert( std::make_pair(pre, line.substr(pos3+1,pos4-pos3-1)) );
+			seqs.insert( std::make_pair(pre, line.substr(pos3+1,pos4-pos3-1)) );
 	};
+	trie = TrieTable( order );
+	leafSeqs = LeafTable( seqs );
 }
 
 
 std::string getProteins(
 		const MinMaxPST_Node& node,
 		const MinMaxPST& leaves,
-		const std::vector< std::pair<size_t,size_t> >& trie,
-		const std::map<size_t,std::string>& leafSeqs ) {
+		const TrieTable& trie,
+		const LeafTable& leafSeqs ) {
 
 	std::vector< MinMaxPST_Node > curPath = { node };
 	
 	bool status = exploreDown( curPath, leaves );
 	assert( status );
-	size_t pre = curPath.back().first;
-	assert( leafSeqs.find(pre) != leafSeqs.end() );
-	std::string seq = leafSeqs.find(pre)->second;
-	LOG("FindProtein: start seq " + seq + " preorder(" + std::to_string(pre) + ")");
+	const size_t leaf = curPath.back().first;
+	size_t pre = leaf;
+	assert( leafSeqs.contains(pre) );
+	size_t length = leafSeqs.length(pre);
+	LOG("FindProtein: start seq " + leafSeqs.at(pre) + " preorder(" + std::to_string(pre) + ")");
 	while (pre != node.first) {
 		assert( pre > node.first );
 		pre = trie.at(pre).second;
-		seq.pop_back();
-		LOG("next " +  seq + " preorder(" + std::to_string(pre) + ")");
+		length--;
+		LOG("next " +  leafSeqs.at(leaf, length) + " preorder(" + std::to_string(pre) + ")");
 	}
 	assert( pre == node.first );
 	
-	return seq;
+	return leafSeqs.at(leaf, length);
 }
 
 /* 
  * MODIFICATION TOLERANT BLOCKED PATTERN MATCHING 
  */
 #ifdef MOD_TOLERANT
+LastOccTable::LastOccTable() {}
+LastOccTable::LastOccTable(const std::vector<char>& o, const SharedArray<size_t>& t) : order(o), table(t) {}
+
+size_t LastOccTable::get(size_t preorder, char a) const {
+	for (size_t i = 0; i < order.size(); i++) {
+		if (order[i] == a)
+			return table[preorder*order.size() + i];
+	}
+	return 0;
+}
+
+size_t LastOccTable::size() const { return order.empty() ? 0 : table.size() / order.size(); }
+
 // check if the last curPath-vertex is valid for curMod.back()
 bool isValidVertex( 
 		std::vector< MinMaxPST_Node >& curPath, 
 		const std::array<std::vector<size_t>,3>& curMod,
-		const std::vector< std::pair<size_t,size_t> >& trie,
-		const std::map<size_t,std::map<char,size_t>>& lastOccAll ) {
+		const TrieTable& trie,
+		const LastOccTable& lastOcc ) {
 
 	const size_t subtreeRoot = (curPath.size() > 1) ? curPath.at(curPath.size()-2).first : 0;
 	const size_t lastNode = curPath.back().first;
-	assert( lastOccAll.find(lastNode) != lastOccAll.end() );
-	const std::map<char,size_t>& lastOcc = lastOccAll.find(lastNode)->second;
+	assert( lastNode < lastOcc.size() );
 
 	auto mod = cfg::allSitesMods.begin();
 	for ( auto a : curMod.at(0) ) {
-			if ( a > 0 && 
-				 (lastOcc.find( mod->first ) == lastOcc.end() ||
-				  lastOcc.find( mod->first )->second <= subtreeRoot) )
+			if ( a > 0 && lastOcc.get( lastNode, mod->first ) <= subtreeRoot )
 			return false;
 			mod++;
 		}
 		mod = cfg::nTermMods.begin();
 		for ( auto a : curMod.at(1) ) {
-			if ( a > 0 && 
-				 (lastOcc.find( mod->first ) == lastOcc.end() ||
-				  lastOcc.find( mod->first )->second <= subtreeRoot) ) {
+			if ( a > 0 && lastOcc.get( lastNode, mod->first ) <= subtreeRoot ) {
 				return false;
-			} else if (a > 0 && lastOcc.find( mod->first ) != lastOcc.end() && lastOcc.find( mod->first )->second > subtreeRoot) {
+			} else if (a > 0) {
 				// check if lastOcc preorder p is really the first character
 				// (i.e. parent is root)
-				const size_t p = lastOcc.find(mod->first)->second;
+				const size_t p = lastOcc.get( lastNode, mod->first );
 				if (trie.at(p).second != 0)
 					return false;
 			}
@@ -300,9 +789,7 @@ bool isValidVertex(
 		}
 		mod = cfg::cTermMods.begin();
 		for ( auto a : curMod.at(2) ) {
-			if ( a > 0 && 
-				 (lastOcc.find( mod->first ) == lastOcc.end() ||
-				  lastOcc.find( mod->first )->second <= subtreeRoot) )
+			if ( a > 0 && lastOcc.get( lastNode, mod->first ) <= subtreeRoot )
 			return false;
 			mod++;
 		}
@@ -313,8 +800,8 @@ bool isValidVertex(
 bool exploreRightMod( 
 	std::vector< MinMaxPST_Node >& curPath, 
 		const std::array<std::vector<size_t>,3>& curMod, 
-		const std::map<size_t,std::map<char,size_t>>& lastOccAll, 
-		const std::vector< std::pair<size_t,size_t> >& trie,
+		const LastOccTable& lastOccAll, 
+		const TrieTable& trie,
 		const MinMaxPST& pst ) {
 	bool res = exploreRight(curPath,pst);
 	if (res) {
@@ -330,8 +817,8 @@ bool exploreRightMod(
 bool exploreDownMod(
 		std::vector< MinMaxPST_Node >& curPath, 
 		const std::array<std::vector<size_t>,3>& curMod, 
-		const std::map<size_t,std::map<char,size_t>>& lastOccAll, 
-		const std::vector< std::pair<size_t,size_t> >& trie,
+		const LastOccTable& lastOccAll, 
+		const TrieTable& trie,
 		const MinMaxPST& pst ) {
 
 	bool res = exploreDown(curPath,pst);
@@ -451,10 +938,10 @@ size_t nextMass( std::vector< std::array<std::vector<size_t>,3> >& curMod, const
 
 
 // return next mod. mass with a non-empty priority search tree
-size_t nextMassWithPST(std::vector< std::array<std::vector<size_t>,3> >& curMod, const std::vector< size_t     >& masses, const std::map< size_t, MinMaxPST >& psts ) {
+size_t nextMassWithPST(std::vector< std::array<std::vector<size_t>,3> >& curMod, const std::vector< size_t     >& masses, const MassDirectory& psts ) {
 
 	size_t tmpMass = nextMass( curMod, masses );
-	while ( psts.find(tmpMass) == psts.end() && tmpMass < std::numeric_limits<size_t>::max() )
+	while ( psts.find( tmpMass ) == nullptr && tmpMass < std::numeric_limits<size_t>::max() )
 		tmpMass = nextMass( curMod, masses );
 	if (tmpMass == std::numeric_limits<size_t>::max()) {
 		std::fill( curMod.back().at(0).begin(), curMod.back().at(0).end(), std::numeric_limits<size_t>::max() );
@@ -466,14 +953,68 @@ size_t nextMassWithPST(std::vector< std::array<std::vector<size_t>,3> >& curMod,
 }
 
 
-std::vector<size_t> findBPMod( std::vector< size_t >& bp,
-							   const std::map< size_t, MinMaxPST >& psts,
-							   const std::vector< std::pair<size_t,size_t> >& trie,
-							   const std::map<size_t,std::map<char,size_t>>& lastOcc ) {
+// largest number of modification mass differences of a prefix that modifiedMassesInIndex checks one by one
+const size_t MAX_MOD_DELTAS = 256;
+
+// sums of one element of a and one of b, without duplicates
+std::vector<long long> sumSet( const std::vector<long long>& a, const std::vector<long long>& b ) {
+	std::vector<long long> res;
+	for (auto x : a)
+		for (auto y : b)
+			res.push_back(x + y);
+	std::sort(res.begin(), res.end());
+	res.erase( std::unique(res.begin(), res.end()), res.end() );
+	return res;
+}
+
+// mass differences of a block with the modifications mods: no or one modification per character
+std::vector<long long> modDeltas( const std::map< char, std::vector<int> >& mods ) {
+	std::vector<long long> res(1, 0);
+	for (auto& a : mods) {
+		std::vector<long long> choices(1, 0);
+		choices.insert(choices.end(), a.second.begin(), a.second.end());
+		res = sumSet(res, choices);
+	}
+	return res;
+}
+
+// false if no modified mass of some prefix of the pattern has a PST, so that findBPMod has no match. A block
+// has no or one modification per character with all-sites modifications, the first block also n-terminal
+// and the last c-terminal ones; the mass differences of a prefix are checked one by one, or as a range if
+// there are more than MAX_MOD_DELTAS
+bool modifiedMassesInIndex( const std::vector<size_t>& masses, const MassDirectory& psts ) {
+	const std::vector<long long> block = modDeltas(cfg::allSitesMods);
+	const std::vector<long long> cTerm = modDeltas(cfg::cTermMods);
+	std::vector<long long> prefix = modDeltas(cfg::nTermMods);
+	bool range = false;		// prefix only holds the smallest and largest mass difference
+	for (size_t d = 0; d < masses.size(); d++) {
+		prefix = sumSet(prefix, block);
+		const std::vector<long long> deltas = (d+1 == masses.size()) ? sumSet(prefix, cTerm) : prefix;
+		const long long m = masses[d];
+		range = range || deltas.size() > MAX_MOD_DELTAS;
+		bool found = false;
+		if (range)
+			found = m + deltas.back() >= 0 && psts.containsRange( std::max(0LL, m + deltas.front()), m + deltas.back() );
+		else
+			for (size_t i = 0; i < deltas.size() && !found; i++)
+				found = m + deltas[i] >= 0 && psts.contains( m + deltas[i] );
+		if (!found)
+			return false;
+		if (range)
+			prefix = { prefix.front(), prefix.back() };
+	}
+	return true;
+}
+
+void findBPMod( std::vector< size_t >& bp,
+				const MassDirectory& psts,
+				const TrieTable& trie,
+				const LastOccTable& lastOcc,
+				const MatchVisitor& visit ) {
 	// curPath stores the currently explored path. The mass of a vertex curPath[i] is masses[i];
 	// we first explore the path downwards at curPath.back(); if no successor, explore to the right (siblings)
 	std::vector< MinMaxPST_Node > curPath; 
-	curPath.push_back(std::make_pair(0,psts.begin()->second.getPosINF()));
+	curPath.push_back(std::make_pair(0,psts.getPST(0).getPosINF()));
 
 	// curMod stores the current modification for each mass of curPath
 	std::vector< std::array<std::vector<size_t>,3> > curMod;
@@ -484,14 +1025,15 @@ std::vector<size_t> findBPMod( std::vector< size_t >& bp,
 	};
 	curMod.push_back( firstMod );
 
-	std::vector<size_t> res;
-	if (bp.size() == 0) return res;
+	if (bp.size() == 0) return;
 
 	std::vector<size_t> masses;
 	masses.reserve(bp.size());
 	masses.push_back(bp.at(0));
 	for (size_t i = 1; i < bp.size(); i++)
 		masses.push_back(masses.back()+bp.at(i));
+	if (!modifiedMassesInIndex(masses, psts))
+		return;
 
 	MinMaxPST_Node queryPoint, nextPoint;
 	bool state = true; // state is true if we have to exploreDown from curPath.back() and otherwise false
@@ -500,21 +1042,22 @@ std::vector<size_t> findBPMod( std::vector< size_t >& bp,
 		assert( curPath.size() == curMod.size() );
 		queryPoint = curPath.back();
 		if (curPath.size() == masses.size()+1) {
-			res.push_back(curPath.back().first);
+			if (!visit(curPath.back().first))
+				return;
 			curPath.pop_back();
 			curMod.pop_back();
 			state = false;
 		} else {
 			tmpMass = getModMass( curMod, curMod.size()-1, masses[curPath.size()-1] );
-			if (tmpMass < std::numeric_limits<size_t>::max() && psts.find( tmpMass ) == psts.end())
+			if (tmpMass < std::numeric_limits<size_t>::max() && psts.find( tmpMass ) == nullptr)
 				tmpMass = nextMassWithPST( curMod, masses, psts );
 
 			if ( tmpMass ==  std::numeric_limits<size_t>::max() ) {
 				if (curPath.size() == 1) break;
 				curMod.pop_back();
 				tmpMass = getModMass( curMod, curMod.size()-1, masses[curPath.size()-2] );
-				assert( psts.find( tmpMass ) != psts.end() );
-				state = exploreRightMod( curPath, curMod.back(), lastOcc, trie, psts.find(tmpMass)->second);
+				assert( psts.find( tmpMass ) != nullptr );
+				state = exploreRightMod( curPath, curMod.back(), lastOcc, trie, *psts.find( tmpMass ));
 				if (state)
 					curMod.push_back(firstMod);
 				else {
@@ -525,7 +1068,7 @@ std::vector<size_t> findBPMod( std::vector< size_t >& bp,
 			
 			
 			if (state) {
-				state = exploreDownMod( curPath, curMod.back(), lastOcc, trie, psts.find( tmpMass )->second );
+				state = exploreDownMod( curPath, curMod.back(), lastOcc, trie, *psts.find( tmpMass ) );
 				if (state) {
 					curMod.push_back(firstMod);
 				}
@@ -541,7 +1084,7 @@ std::vector<size_t> findBPMod( std::vector< size_t >& bp,
 				} else {
 					if ( nextMassWithPST( curMod, masses, psts ) == std::numeric_limits<size_t>::max() ) {
 						tmpMass = getModMass( curMod, curMod.size()-2, masses[curPath.size()-2] );
-						state = exploreRightMod( curPath, curMod.at(curMod.size()-2), lastOcc, trie, psts.find(tmpMass)->second );
+						state = exploreRightMod( curPath, curMod.at(curMod.size()-2), lastOcc, trie, *psts.find( tmpMass ) );
 						if (state)
 							curMod.back() = firstMod;
 						else
@@ -552,6 +1095,14 @@ std::vector<size_t> findBPMod( std::vector< size_t >& bp,
 			}
 		}
 	} while (curPath.size() > 0);
+}
+
+std::vector<size_t> findBPMod( std::vector< size_t >& bp,
+							   const MassDirectory& psts,
+							   const TrieTable& trie,
+							   const LastOccTable& lastOcc ) {
+	std::vector<size_t> res;
+	findBPMod(bp, psts, trie, lastOcc, [&res](size_t v) { res.push_back(v); return true; });
 	return res;
 }
 
@@ -592,13 +1143,29 @@ std::map<char,size_t> readMap( std::string s, std::vector<char> order ) {
 }
 
 void readDBFileMod( std::string file,
-					std::map<size_t, MinMaxPST>& psts,
+					MassDirectory& psts,
 					MinMaxPST*& leaves,
-					std::vector< std::pair<size_t,size_t> >& trie,
-					std::map<size_t,std::string>& leafSeqs,
-					std::map< size_t, std::map<char,size_t> >& lastOcc ) {
+					TrieTable& trie,
+					LeafTable& leafSeqs,
+					LastOccTable& lastOcc ) {
 	readDBFile(file, psts, leaves, trie, leafSeqs);
-	
+
+	if (IndexFile::isIndexFile(file)) {
+		IndexFile index(file);
+		if (!index.good())
+			return;
+		if (!(index.getFlags() & INDEX_FLAG_LASTOCC)) {
+			std::cout << "ERROR: " << file << " contains no lastOcc table - probably index file has not been generated for modification-tolerant BPM" << std::endl;
+			return;
+		}
+		size_t k, n;
+		const char* order = index.getSection<char>(SECTION_LASTOCC_ORDER, k);
+		const size_t* table = index.getSection<size_t>(SECTION_LASTOCC, n);
+		lastOcc = LastOccTable( std::vector<char>(order, order+k), SharedArray<size_t>(table, n, index.getStorage()) );
+		return;
+	}
+
+	// text format
 	std::ifstream db(file);
 	if (!db.good()) return;
 	std::string line;
@@ -610,6 +1177,7 @@ void readDBFileMod( std::string file,
 		lastOccOrder = readCharArray( line.substr(14,line.size()) );
 		break;
 	}
+	std::vector<size_t> table(trie.size() * lastOccOrder.size(), 0);
 	std::string::size_type pos;
 	size_t pre;
 	while (std::getline(db, line)) {
@@ -623,8 +1191,10 @@ void readDBFileMod( std::string file,
 		pos = line.find(',',pos+1); // skip parent_preorder
 		pos = line.find(',',pos+1); // skip sequence
 		std::map<char,size_t> m = readMap(line.substr(pos,line.size()), lastOccOrder);
-		lastOcc.insert( std::make_pair( pre, m ) );
+		for (size_t i = 0; i < lastOccOrder.size(); i++)
+			table.at(pre*lastOccOrder.size() + i) = m.find(lastOccOrder.at(i))->second;
 	}
+	lastOcc = LastOccTable( lastOccOrder, SharedArray<size_t>(std::move(table)) );
 }
 #endif
 
@@ -632,6 +1202,28 @@ void readDBFileMod( std::string file,
  * MUTATION TOLERANT BLOCKED PATTERN MATCHING
  */
 #ifdef MUT_TOLERANT
+LinkTable::LinkTable() {}
+LinkTable::LinkTable(const SharedArray<size_t>& o, const SharedArray<size_t>& l) : offsets(o), links(l) {}
+LinkTable::LinkTable(const std::unordered_map< size_t, std::vector<size_t> >& l, size_t nrNodes) {
+	std::vector<size_t> o(nrNodes+1, 0);
+	for ( auto a : l )
+		o.at(a.first+1) = a.second.size();
+	for (size_t i = 1; i <= nrNodes; i++)
+		o.at(i) += o.at(i-1);
+	std::vector<size_t> targets(o.back());
+	for ( auto a : l )
+		std::copy( a.second.begin(), a.second.end(), targets.begin() + o.at(a.first) );
+	offsets = SharedArray<size_t>(std::move(o));
+	links = SharedArray<size_t>(std::move(targets));
+}
+
+bool LinkTable::empty() const { return links.empty(); }
+bool LinkTable::hasLinks(size_t preorder) const { return preorder+1 < offsets.size() && offsets[preorder+1] > offsets[preorder]; }
+const size_t* LinkTable::begin(size_t preorder) const { return links.begin() + offsets[preorder]; }
+const size_t* LinkTable::end(size_t preorder) const { return links.begin() + offsets[preorder+1]; }
+const SharedArray<size_t>& LinkTable::getOffsets() const { return offsets; }
+const SharedArray<size_t>& LinkTable::getLinks() const { return links; }
+
 // check if mass can be explained by one mutation at seq
 bool isPossibleModification( std::string seq, size_t mass ) {
 	size_t diff;
@@ -668,26 +1260,53 @@ bool isPossibleModification( std::string seq, size_t mass ) {
 	return false;
 }
 
+// node below v (at depth d) whose sequence is the one of v followed by seq; the children of a node follow each
+// other in preorder, and the first leaf in the subtree of a child has its character at position d
+size_t descend(
+		size_t v,
+		size_t d,
+		const std::string& seq,
+		const TrieTable& trie,
+		const MinMaxPST& leaves,
+		const LeafTable& leafSeqs ) {
+
+	for ( auto c : seq ) {
+		const size_t end = v + trie.subtreeSize(v);
+		size_t child = v + 1;
+		for ( ; child < end; child += trie.subtreeSize(child) ) {
+			std::vector< MinMaxPST_Node > curPath = { std::make_pair(child,trie.at(child).first) };
+			bool status = exploreDown( curPath, leaves );
+			assert( status );
+			if ( leafSeqs.at(curPath.back().first, d+1).back() == c )
+				break;
+		}
+		assert( child < end );
+		v = child;
+		d++;
+	}
+	return v;
+}
+
 // try to combine prefix match and suffix match (preorder number given) for a block mass,
 // i.e. check if suffix has a link in prefix subtree and if seq can be explained by 
-// one modification, and add to results if so;
-// return true if combination is possible and false otherwise.
+// one modification, and pass the match to visit if so;
+// return false if visit stopped the search and true otherwise.
 bool combine(
 		size_t prefix,
 		size_t suffix,
 		size_t mass,
-		const std::unordered_map< size_t, std::vector<size_t> >& links,
-		const std::vector< std::pair<size_t,size_t> >& trie,
+		const LinkTable& links,
+		const TrieTable& trie,
 		const MinMaxPST& leaves,
-		const std::map< size_t, std::string >& leafSeqs,
-		std::vector<std::string>& results ) {
+		const LeafTable& leafSeqs,
+		const SequenceVisitor& visit ) {
 
-	if (links.find(suffix) == links.end())
-		return false;
-	bool found = false;
+	if (!links.hasLinks(suffix))
+		return true;
 	const MinMaxPST_Node suf = {suffix, trie.at(suffix).first};
 	const std::string sufseq = getProteins( suf, leaves, trie, leafSeqs);
-	for ( auto a : links.find(suffix)->second ) {
+	for ( auto it = links.begin(suffix); it != links.end(suffix); it++ ) {
+		const size_t a = *it;
 		if ( a > prefix && trie.at(a).first < trie.at(prefix).first ) {
 			// a is in subtree of prefix
 
@@ -711,37 +1330,40 @@ bool combine(
 
 			// check if mass can be explained by seq (w/ one mutation)
 			if( isPossibleModification(seq, mass) ) {
-				found = true;
 				MinMaxPST_Node pre = {a, trie.at(a).first};
-				results.push_back( getProteins( pre, leaves, trie, leafSeqs ) + sufseq );
+				const std::string preseq = getProteins( pre, leaves, trie, leafSeqs );
+				if (!visit( preseq + sufseq, descend(a, preseq.size(), sufseq, trie, leaves, leafSeqs) ))
+					return false;
 			}
 		}
 	}
-	return found;
+	return true;
 }
 
+// leaves in the subtree of n (including n) that have no leaf ancestor below n, in preorder
 std::vector<size_t> getLeavesInSubtree( const MinMaxPST_Node& n, const MinMaxPST& leaves ) {
 	std::vector<size_t> res;
-	std::vector< MinMaxPST_Node > curPath = { n };
-	bool status = exploreDown( curPath, leaves );
-	while( status ) {
-		res.push_back( curPath.back().first );
-		status = exploreRight( curPath, leaves );
+	size_t last = 0;	// postorder of the last reported leaf
+	for ( auto a : leaves.enumerateUp( n.first, leaves.getPosINF(), n.second ) ) {
+		if ( !res.empty() && a.second < last )
+			continue; // in the subtree of the last reported leaf
+		res.push_back( a.first );
+		last = a.second;
 	}
 	return res;
 }
 
-
+// pass each sequence from prefix into a leaf below it whose last part can be explained by mass
+// (w/ one mutation) to visit; return false if visit stopped the search and true otherwise.
 bool combineWithLeaf(
 		size_t prefix,
 		size_t mass,
-		const std::unordered_map< size_t, std::vector<size_t> >& links,
-		const std::vector< std::pair<size_t,size_t> >& trie,
+		const LinkTable& links,
+		const TrieTable& trie,
 		const MinMaxPST& leaves,
-		const std::map< size_t, std::string >& leafSeqs,
-		std::vector<std::string>& results ) {
+		const LeafTable& leafSeqs,
+		const SequenceVisitor& visit ) {
 
-	bool found = false;
 	for ( auto a : getLeavesInSubtree({prefix,trie.at(prefix).first}, leaves) ) {
 		// extract sequence between prefix and a
 		std::vector< MinMaxPST_Node > curPath = { std::make_pair(a,trie.at(a).first) };
@@ -758,23 +1380,27 @@ bool combineWithLeaf(
 		for (size_t i = 1; i < seq.size()-count; i++) {
 			// check if mass can be explained by seq (w/ one mutation)
 			if( isPossibleModification(seq.substr(seq.size()-count,i), mass) ) {
-				found = true;
-				results.push_back( seq.substr(0,seq.size()-count+i) );
+				// the node of the match is the ancestor of the leaf at its length
+				size_t node = curPath.back().first;
+				for (size_t j = i; j < count; j++)
+					node = trie.at(node).second;
+				if (!visit( seq.substr(0,seq.size()-count+i), node ))
+					return false;
 			}
 		}
 	}
-	return found;
+	return true;
 }
 
-std::vector<std::string> findBPMut( std::vector< size_t >& masses,
-							   const std::map< size_t,MinMaxPST >& psts,
-							   const std::unordered_map< size_t, std::vector<size_t> >& links,
-							   const std::vector< std::pair<size_t,size_t> >& trie,
-							   const MinMaxPST& leaves,
-							   const std::map< size_t, std::string >& leafSeqs
-							   ) {
-	std::vector<std::string> res;
-	if (masses.size() == 0) return res;
+void findBPMut( std::vector< size_t >& masses,
+				const MassDirectory& psts,
+				const LinkTable& links,
+				const TrieTable& trie,
+				const MinMaxPST& leaves,
+				const LeafTable& leafSeqs,
+				const SequenceVisitor& visit
+				) {
+	if (masses.size() == 0) return;
 
 	for ( size_t i = 0; i < masses.size(); i++ ) {
 		// mutation in masses.at(i)
@@ -794,32 +1420,58 @@ std::vector<std::string> findBPMut( std::vector< size_t >& masses,
 
 			for (auto p : prefixMatch) {
 				for (auto s : suffixMatch)
-					combine(p,s,masses.at(i),links,trie,leaves,leafSeqs,res);
+					if (!combine(p,s,masses.at(i),links,trie,leaves,leafSeqs,visit))
+						return;
 			}
 		} else if ( i == 0 ) {
 			// mutation in first block
 			std::vector<size_t> suffixMatch = findBP(suffixMasses, psts);
 			for (auto s : suffixMatch) 
-				combine(0,s,masses.at(0),links,trie,leaves,leafSeqs,res);
+				if (!combine(0,s,masses.at(0),links,trie,leaves,leafSeqs,visit))
+					return;
 		} else {
 			// mutation in last block
 			std::vector<size_t> prefixMatch = findBP(prefixMasses, psts);
 			for (auto p : prefixMatch)
-				combineWithLeaf(p,masses.back(),links,trie,leaves,leafSeqs,res);
+				if (!combineWithLeaf(p,masses.back(),links,trie,leaves,leafSeqs,visit))
+					return;
 		}
 	}
+}
 
+std::vector<std::string> findBPMut( std::vector< size_t >& masses,
+							   const MassDirectory& psts,
+							   const LinkTable& links,
+							   const TrieTable& trie,
+							   const MinMaxPST& leaves,
+							   const LeafTable& leafSeqs
+							   ) {
+	std::vector<std::string> res;
+	findBPMut(masses, psts, links, trie, leaves, leafSeqs, [&res](const std::string& s, size_t) { res.push_back(s); return true; });
 	return res;
 }
 
 void readDBFileMut( std::string file,
-					std::map<size_t, MinMaxPST>& psts,
+					MassDirectory& psts,
 					MinMaxPST*& leaves,
-					std::vector< std::pair<size_t,size_t> >& trie,
-					std::map<size_t,std::string>& leafSeqs,
-					std::unordered_map< size_t, std::vector<size_t> >& links ) {
+					TrieTable& trie,
+					LeafTable& leafSeqs,
+					LinkTable& links ) {
 	readDBFile(file, psts, leaves, trie, leafSeqs);
-	
+
+	if (IndexFile::isIndexFile(file)) {
+		IndexFile index(file);
+		if (!index.good() || !(index.getFlags() & INDEX_FLAG_LINKS))
+			return;
+		size_t n, m;
+		const size_t* offsets = index.getSection<size_t>(SECTION_LINK_OFFSETS, n);
+		const size_t* targets = index.getSection<size_t>(SECTION_LINKS, m);
+		links = LinkTable( SharedArray<size_t>(offsets, n, index.getStorage()), SharedArray<size_t>(targets, m, index.getStorage()) );
+		return;
+	}
+
+	// text format
+	std::unordered_map< size_t, std::vector<size_t> > linkMap;
 	std::ifstream db(file);
 	if (!db.good()) return;
 	std::string line;
@@ -847,8 +1499,8 @@ void readDBFileMut( std::string file,
 		assert( p2 != std::string::npos );
 		std::stringstream sstream( line.substr(p1+1,p2-p1) );
 		sstream >> len;
-		links.insert( std::make_pair( pre, std::vector<size_t>() ) );
-		std::vector<size_t>& linkvector = links.find(pre)->second;
+		linkMap.insert( std::make_pair( pre, std::vector<size_t>() ) );
+		std::vector<size_t>& linkvector = linkMap.find(pre)->second;
 		linkvector.reserve(len);
 
 		size_t l;
@@ -861,5 +1513,6 @@ void readDBFileMut( std::string file,
 		}
 		assert(linkvector.size() == len);
 	}
+	links = LinkTable( linkMap, trie.size() );
 }
 #endif
@@ -9,56 +9,210 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <functional>
 #include "minmaxpst.h"
+#include "massDirectory.h"
+#include "sharedArray.h"
+#include "frontierCache.h"
 
 size_t getMass(const std::string& seq);
 
+struct LeafEntry {
+	uint64_t preorder;
+	uint64_t offset;	// first char in the protein text
+	uint64_t length;
+};
+
+// sequence of each leaf (by preorder) as a substring of the concatenated protein text
+class LeafTable {
+	private:
+		SharedArray<LeafEntry> dir;		// sorted by preorder
+		SharedArray<char> text;
+
+		const LeafEntry& find(size_t preorder) const;
+
+	public:
+		LeafTable();
+		LeafTable(const SharedArray<LeafEntry>& dir, const SharedArray<char>& text);
+		LeafTable(const std::map<size_t,std::string>& leafSeqs); // one copy of the sequence per leaf
+		bool contains(size_t preorder) const;
+		size_t size() const; // nr of leaves
+		size_t length(size_t preorder) const;
+		size_t count(size_t first, size_t last) const; // nr of leaves with preorder in [first,last)
+		std::string at(size_t preorder) const;
+		std::string at(size_t preorder, size_t length) const; // prefix of the sequence
+		const SharedArray<LeafEntry>& getDir() const;
+		const SharedArray<char>& getText() const;
+};
+
+// postorder and parent preorder of each trie node (by preorder), stored with 32 or 64 bit per value
+class TrieTable {
+	private:
+		SharedArray<uint32_t> t32;		// <postorder, parent preorder> pairs if width is 4
+		SharedArray<uint64_t> t64;		// <postorder, parent preorder> pairs if width is 8
+		size_t width;
+
+	public:
+		TrieTable();
+		TrieTable(const std::vector< std::pair<size_t,size_t> >& trie, size_t width = sizeof(size_t));
+		TrieTable(const void* data, size_t size, size_t width, std::shared_ptr<const void> storage);
+		TrieTable(const SharedArray<uint32_t>& t32); // consecutive <postorder, parent preorder> values
+		TrieTable(const SharedArray<uint64_t>& t64);
+		std::pair<size_t,size_t> at(size_t preorder) const;
+		size_t size() const; // nr of trie nodes
+		size_t depth(size_t preorder) const; // nr of edges to the root
+		size_t subtreeSize(size_t preorder) const; // nr of nodes in the subtree, including the node itself
+		size_t getWidth() const; // bytes per value
+		const void* data() const;
+};
+
+// called with each match of a block pattern (the preorder of its last node, or the matched sequence and
+// the preorder of its node for mutations) in the order of the result vectors; returning false stops the search
+typedef std::function<bool(size_t)> MatchVisitor;
+typedef std::function<bool(const std::string&, size_t)> SequenceVisitor;
+
+size_t planAnchor( const std::vector< const MinMaxPST* >& pst ); // block to start the search at, given the PSTs of the prefix masses
 std::vector<size_t> findBP( std::vector< size_t >& masses,
-							const std::map< size_t,MinMaxPST >& psts);
+							const MassDirectory& psts);
+void findBP( std::vector< size_t >& masses,
+			 const MassDirectory& psts,
+			 const MatchVisitor& visit,
+			 FrontierCache* cache = nullptr);	// resumes from and adds the nodes matched by leading blocks
+
+// tolerance of the prefix masses of a block pattern: absolute (in the units of the masses) plus ppm of the mass
+struct MassTolerance {
+	size_t absolute;
+	size_t ppm;
+	size_t at(size_t mass) const;
+	bool exact() const;
+};
+bool readMassTolerance( const std::string& s, MassTolerance& tol ); // "<absolute>" or "<ppm>ppm", false if s is malformed
+// nodes whose mass is within the tolerance of the sum of the first d blocks, for each d, on a path
+std::vector<size_t> findBP( std::vector< size_t >& masses,
+							const MassDirectory& psts,
+							const MassTolerance& tol);
+void findBP( std::vector< size_t >& masses,
+			 const MassDirectory& psts,
+			 const MassTolerance& tol,
+			 const MatchVisitor& visit);
+// findBP for each block pattern of a batch (bps[first..last)); patterns with common leading blocks share their search
+std::vector< std::vector<size_t> > findBPBatch( const std::vector< std::vector<size_t> >& bps,
+												const MassDirectory& psts);
+std::vector< std::vector<size_t> > findBPBatch( const std::vector< std::vector<size_t> >& bps,
+												size_t first, size_t last,
+												const MassDirectory& psts,
+												FrontierCache* cache = nullptr);
+// called with the index of a pattern of the batch and a match of it, for the patterns in input order and their
+// matches in the order of findBP; returning false stops the search of that pattern
+typedef std::function<bool(size_t,size_t)> BatchVisitor;
+void findBPBatch( const std::vector< std::vector<size_t> >& bps,
+				  size_t first, size_t last,
+				  const MassDirectory& psts,
+				  const BatchVisitor& visit,
+				  FrontierCache* cache = nullptr);
+
+// nr of matches of a block pattern, and nr of leaves (indexed sequences) in the subtrees of the matches
+struct MatchCount {
+	size_t matches;
+	size_t leaves;
+};
+size_t countLeaves( size_t preorder, const TrieTable& trie, const LeafTable& leafSeqs ); // in the subtree of the node, without enumerating them
+MatchCount countBP( std::vector< size_t >& masses,
+					const MassDirectory& psts,
+					const TrieTable& trie,
+					const LeafTable& leafSeqs);
 
 void readBP( std::string line, std::vector<size_t>& bp );
 void readBPFile( std::string file, std::vector<std::vector<size_t> >& bps );
 
 void readDBFile( std::string file,
-				 std::map<size_t, MinMaxPST>& psts,
+				 MassDirectory& psts,
 				 MinMaxPST*& leaves,
-				 std::vector< std::pair<size_t,size_t> >& trie,
-				 std::map<size_t,std::string>& leafSeqs ); // read file and write psts, trie, leaves, and leafSeqs (for each leaf the corresponding sequence
+				 TrieTable& trie,
+				 LeafTable& leafSeqs ); // read file (binary index or text format) and write psts, trie, leaves, and leafSeqs (for each leaf the corresponding sequence
 
 std::string getProteins(
 				const MinMaxPST_Node& node,
 				const MinMaxPST& leaves,
-				const std::vector< std::pair<size_t,size_t> >& trie,
-				const std::map<size_t,std::string>& leafSeqs ); // return sequence and all proteins which contain this string
+				const TrieTable& trie,
+				const LeafTable& leafSeqs ); // return sequence and all proteins which contain this string
 
 #ifdef MOD_TOLERANT
+// preorder label of the last occurence of each modified character on the path to the root, for each trie node
+class LastOccTable {
+	private:
+		std::vector<char> order;		// characters of the table columns
+		SharedArray<size_t> table;		// table[preorder*order.size() + column]
+
+	public:
+		LastOccTable();
+		LastOccTable(const std::vector<char>& order, const SharedArray<size_t>& table);
+		size_t get(size_t preorder, char a) const; // 0 if a is not a modified character
+		size_t size() const; // nr of trie nodes
+};
+
+bool modifiedMassesInIndex( const std::vector<size_t>& masses, const MassDirectory& psts ); // false if some prefix mass has no PST with any modifications
 std::vector<size_t> findBPMod( std::vector< size_t >& masses,
-							   const std::map< size_t, MinMaxPST >& psts,
-							   const std::vector< std::pair<size_t,size_t> >& trie,
-							   const std::map<size_t, std::map<char,size_t>>& lastOcc);
+							   const MassDirectory& psts,
+							   const TrieTable& trie,
+							   const LastOccTable& lastOcc);
+void findBPMod( std::vector< size_t >& masses,
+				const MassDirectory& psts,
+				const TrieTable& trie,
+				const LastOccTable& lastOcc,
+				const MatchVisitor& visit);
 
 void readDBFileMod( std::string file,
-					std::map<size_t, MinMaxPST>& psts,
+					MassDirectory& psts,
 					MinMaxPST*& leaves,
-					std::vector< std::pair<size_t,size_t> >& trie,
-					std::map< size_t, std::string >& leafSeqs,
-					std::map< size_t, std::map<char,size_t> >& lastOcc );
+					TrieTable& trie,
+					LeafTable& leafSeqs,
+					LastOccTable& lastOcc );
 #endif
 
 #ifdef MUT_TOLERANT
+// links of each trie node (by preorder), stored as one array grouped by preorder
+class LinkTable {
+	private:
+		SharedArray<size_t> offsets;	// links of preorder p are links[offsets[p]..offsets[p+1])
+		SharedArray<size_t> links;
+
+	public:
+		LinkTable();
+		LinkTable(const SharedArray<size_t>& offsets, const SharedArray<size_t>& links);
+		LinkTable(const std::unordered_map< size_t, std::vector<size_t> >& links, size_t nrNodes);
+		bool empty() const; // true if there are no links at all
+		bool hasLinks(size_t preorder) const;
+		const size_t* begin(size_t preorder) const;
+		const size_t* end(size_t preorder) const;
+		const SharedArray<size_t>& getOffsets() const;
+		const SharedArray<size_t>& getLinks() const;
+};
+
 std::vector<std::string> findBPMut( std::vector< size_t >& masses,
-									const std::map< size_t, MinMaxPST >& psts,
-									const std::unordered_map< size_t, std::vector<size_t> >& links,
-									const std::vector< std::pair<size_t,size_t> >& trie,
+									const MassDirectory& psts,
+									const LinkTable& links,
+									const TrieTable& trie,
 									const MinMaxPST& leaves,
-									const std::map< size_t, std::string >& leafSeqs
+									const LeafTable& leafSeqs
 									);
+void findBPMut( std::vector< size_t >& masses,
+				const MassDirectory& psts,
+				const LinkTable& links,
+				const TrieTable& trie,
+				const MinMaxPST& leaves,
+				const LeafTable& leafSeqs,
+				const SequenceVisitor& visit
+				);
 
 void readDBFileMut( std::string file,
-					std::map<size_t, MinMaxPST>& psts,
+					MassDirectory& psts,
 					MinMaxPST*& leaves,
-					std::vector< std::pair<size_t,size_t> >& trie,
-					std::map< size_t, std::string >& leafSeqs,
-					std::unordered_map< size_t, std::vector<size_t> >& links );
+					TrieTable& trie,
+					LeafTable& leafSeqs,
+					LinkTable& links );
 #endif
 #endif
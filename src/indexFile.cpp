@@ -0,0 +1,223 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "minmaxpst.h"
+#include "helpers.h"
+#include "indexFile.h"
+
+static_assert( sizeof(size_t) == sizeof(uint64_t), "the index file stores size_t values as 64 bit integers" );
+
+//#define DEBUG
+#ifdef DEBUG
+#	define LOG(x) std::clog << "DEBUG: " << x << std::endl;
+#else
+#	define LOG(x) do {} while (0)
+#endif
+
+
+/*
+ * MappedFile class implementation
+ */
+
+MappedFile::MappedFile(const std::string& filename) : data(nullptr), length(0) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cout << "ERROR: " << filename << " not found. Abort." << std::endl;
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+			std::cout << "ERROR: mapping " << filename << " failed." << std::endl;
+		else {
+			data = static_cast<const char*>(p);
+			length = st.st_size;
+		}
+	}
+	::close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data != nullptr)
+		munmap(const_cast<char*>(data), length);
+}
+
+bool MappedFile::good() const { return data != nullptr; }
+const char* MappedFile::begin() const { return data; }
+size_t MappedFile::size() const { return length; }
+
+
+/*
+ * IndexWriter class implementation
+ */
+
+IndexWriter::IndexWriter(const std::string& filename, size_t nrNodes, size_t coordWidth, PSTLayout l) : layout(l), pstNodes(0), pstsOpen(false) {
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.byteOrder = INDEX_BYTE_ORDER;
+	header.nrNodes = nrNodes;
+	header.coordWidth = coordWidth;
+	if (layout == PST_LAYOUT_BLOCKED)
+		header.flags |= INDEX_FLAG_BLOCKED;
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		header.flags |= INDEX_FLAG_RANGE_TREE;
+
+	out.open(filename, std::ios::binary | std::ios::trunc);
+	if (!out.good()) {
+		std::cout << "ERROR: cannot write " << filename << std::endl;
+		return;
+	}
+	// placeholder, the header is written by close()
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+IndexWriter::~IndexWriter() {
+	if (out.is_open())
+		close();
+}
+
+bool IndexWriter::good() const { return out.good(); }
+
+void IndexWriter::beginSection(IndexSectionID id) {
+	const size_t pos = out.tellp();
+	const size_t aligned = (pos + 7) & ~size_t(7);
+	for (size_t i = pos; i < aligned; i++)
+		out.put(0);
+	header.sections[id].offset = aligned;
+}
+
+void IndexWriter::endSection(IndexSectionID id) {
+	header.sections[id].size = size_t(out.tellp()) - header.sections[id].offset;
+	LOG("section " + std::to_string(id) + ": " + std::to_string(header.sections[id].size) + " bytes");
+}
+
+void IndexWriter::writeSection(IndexSectionID id, const void* data, size_t size) {
+	closePSTs();
+	beginSection(id);
+	out.write(static_cast<const char*>(data), size);
+	endSection(id);
+}
+
+void IndexWriter::closePSTs() {
+	if (pstsOpen) {
+		endSection(SECTION_PSTS);
+		pstsOpen = false;
+	}
+}
+
+void IndexWriter::addPST(size_t mass, const MinMaxPST& pst) {
+	assert( masses.empty() || masses.back().mass < mass );
+	if (!pstsOpen) {
+		assert( masses.empty() );
+		beginSection(SECTION_PSTS);
+		pstsOpen = true;
+	}
+	assert( pst.getWidth() == header.coordWidth );
+	assert( pst.getLayout() == layout );
+	MassEntry e = { mass, pstNodes, pst.size() };
+	masses.push_back(e);
+	const size_t nodes = MinMaxPST::arraySize(pst.size(), layout);
+	out.write(static_cast<const char*>(pst.data()), nodes*2*pst.getWidth());
+	pstNodes += nodes;
+}
+
+void IndexWriter::writeLeaves(const MinMaxPST& leaves) {
+	assert( leaves.getWidth() == header.coordWidth );
+	assert( leaves.getLayout() == layout );
+	writeSection(SECTION_LEAVES, leaves.data(), MinMaxPST::arraySize(leaves.size(), layout)*2*leaves.getWidth());
+}
+
+void IndexWriter::writeTrie(const TrieTable& trie) {
+	assert( trie.size() == header.nrNodes && trie.getWidth() == header.coordWidth );
+	writeSection(SECTION_TRIE, trie.data(), trie.size()*2*trie.getWidth());
+}
+
+void IndexWriter::writeLeafSeqs(const LeafTable& leafSeqs) {
+	writeSection(SECTION_LEAFDIR, leafSeqs.getDir().data(), leafSeqs.getDir().size()*sizeof(LeafEntry));
+	writeSection(SECTION_LEAFTEXT, leafSeqs.getText().data(), leafSeqs.getText().size());
+}
+
+void IndexWriter::writeLastOcc(const std::vector<char>& order, const std::vector<size_t>& table) {
+	assert( table.size() == order.size() * header.nrNodes );
+	header.flags |= INDEX_FLAG_LASTOCC;
+	writeSection(SECTION_LASTOCC_ORDER, order.data(), order.size());
+	writeSection(SECTION_LASTOCC, table.data(), table.size()*sizeof(size_t));
+}
+
+void IndexWriter::writeLinks(const SharedArray<size_t>& offsets, const SharedArray<size_t>& links) {
+	assert( offsets.size() == header.nrNodes+1 );
+	header.flags |= INDEX_FLAG_LINKS;
+	writeSection(SECTION_LINK_OFFSETS, offsets.data(), offsets.size()*sizeof(size_t));
+	writeSection(SECTION_LINKS, links.data(), links.size()*sizeof(size_t));
+}
+
+void IndexWriter::close() {
+	writeSection(SECTION_MASSES, masses.data(), masses.size()*sizeof(MassEntry));
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.close();
+}
+
+
+/*
+ * IndexFile class implementation
+ */
+
+IndexFile::IndexFile(const std::string& filename) : header(nullptr) {
+	file = std::make_shared<const MappedFile>(filename);
+	if (!file->good())
+		return;
+	if (file->size() < sizeof(IndexHeader) || std::memcmp(file->begin(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+		std::cout << "ERROR: " << filename << " is not a binary index file." << std::endl;
+		return;
+	}
+	const IndexHeader* h = reinterpret_cast<const IndexHeader*>(file->begin());
+	if (h->version != INDEX_VERSION || h->byteOrder != INDEX_BYTE_ORDER || (h->coordWidth != sizeof(uint32_t) && h->coordWidth != sizeof(uint64_t))) {
+		std::cout << "ERROR: " << filename << " has index version " << h->version << " (expected " << INDEX_VERSION << "), a different byte order or an unsupported coordinate width. Please rebuild the index." << std::endl;
+		return;
+	}
+	for (size_t i = 0; i < NR_SECTIONS; i++) {
+		if (h->sections[i].offset + h->sections[i].size > file->size() || h->sections[i].offset % 8 != 0) {
+			std::cout << "ERROR: " << filename << " is truncated or corrupt." << std::endl;
+			return;
+		}
+	}
+	header = h;
+	LOG("mapped index " + filename + " with " + std::to_string(header->nrNodes) + " trie nodes");
+}
+
+IndexFile::~IndexFile() {}
+
+bool IndexFile::isIndexFile(const std::string& filename) {
+	std::ifstream in(filename, std::ios::binary);
+	char magic[sizeof(INDEX_MAGIC)];
+	if (!in.read(magic, sizeof(magic)))
+		return false;
+	return std::memcmp(magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0;
+}
+
+bool IndexFile::good() const { return header != nullptr; }
+uint32_t IndexFile::getFlags() const { return header->flags; }
+size_t IndexFile::getNrNodes() const { return header->nrNodes; }
+size_t IndexFile::getCoordWidth() const { return header->coordWidth; }
+PSTLayout IndexFile::getLayout() const {
+	if (header->flags & INDEX_FLAG_RANGE_TREE)
+		return PST_LAYOUT_RANGE_TREE;
+	return (header->flags & INDEX_FLAG_BLOCKED) ? PST_LAYOUT_BLOCKED : PST_LAYOUT_HEAP;
+}
+std::shared_ptr<const void> IndexFile::getStorage() const { return file; }
@@ -0,0 +1,145 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef INDEXFILE_H
+#define INDEXFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <memory>
+
+#include "minmaxpst.h"
+#include "sharedArray.h"
+#include "helpers.h"
+
+/*
+ * Binary index layout (all values in native byte order, sections 8-byte aligned,
+ * coordinates and trie entries with coordWidth bytes):
+ *
+ *   IndexHeader
+ *   SECTION_PSTS         PST nodes           arrays of all mass PSTs, one after another (heap, blocked or range tree layout)
+ *   SECTION_LEAVES       PST nodes           array of the leaves PST (same layout)
+ *   SECTION_TRIE         TrieTable           <postorder, parent preorder> for each preorder
+ *   SECTION_LEAFDIR      LeafEntry[]         sequence of each leaf in SECTION_LEAFTEXT, sorted by preorder
+ *   SECTION_LEAFTEXT     char[]              protein sequences, each stored once
+ *   SECTION_LASTOCC_ORDER char[]             characters of the lastOcc table   (MOD_TOLERANT)
+ *   SECTION_LASTOCC      uint64_t[]          lastOcc preorder per node and char (MOD_TOLERANT)
+ *   SECTION_LINK_OFFSETS uint64_t[]          nrNodes+1 offsets into SECTION_LINKS (MUT_TOLERANT)
+ *   SECTION_LINKS        uint64_t[]          link targets grouped by preorder     (MUT_TOLERANT)
+ *   SECTION_MASSES       MassEntry[]         mass directory, sorted by mass
+ */
+
+const char INDEX_MAGIC[8] = { 'B','P','M','I','N','D','E','X' };
+const uint32_t INDEX_VERSION = 3;
+const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+const uint32_t INDEX_FLAG_LASTOCC = 1;		// lastOcc table present
+const uint32_t INDEX_FLAG_LINKS = 2;		// links present
+const uint32_t INDEX_FLAG_BLOCKED = 4;		// PSTs in blocked layout (see PSTLayout)
+const uint32_t INDEX_FLAG_RANGE_TREE = 8;	// range trees instead of PSTs (see PSTLayout)
+
+enum IndexSectionID {
+	SECTION_MASSES,
+	SECTION_PSTS,
+	SECTION_LEAVES,
+	SECTION_TRIE,
+	SECTION_LEAFDIR,
+	SECTION_LEAFTEXT,
+	SECTION_LASTOCC_ORDER,
+	SECTION_LASTOCC,
+	SECTION_LINK_OFFSETS,
+	SECTION_LINKS,
+	NR_SECTIONS
+};
+
+struct IndexSection {
+	uint64_t offset;	// in bytes from the start of the file
+	uint64_t size;		// in bytes
+};
+
+struct IndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t flags;
+	uint32_t coordWidth;	// bytes per coordinate (4 or 8)
+	uint64_t nrNodes;
+	IndexSection sections[NR_SECTIONS];
+};
+
+struct MassEntry {
+	uint64_t mass;
+	uint64_t offset;	// first node in SECTION_PSTS
+	uint64_t size;		// nr of points, in MinMaxPST::arraySize(size, layout) nodes
+};
+
+// read-only memory mapping of a whole file
+class MappedFile {
+	private:
+		const char* data;
+		size_t length;
+
+	public:
+		MappedFile(const std::string& filename);
+		~MappedFile();
+		bool good() const;
+		const char* begin() const;
+		size_t size() const;
+};
+
+class IndexWriter {
+	private:
+		std::ofstream out;
+		IndexHeader header;
+		std::vector<MassEntry> masses;
+		PSTLayout layout;
+		size_t pstNodes;
+		bool pstsOpen;
+
+		void beginSection(IndexSectionID id);
+		void endSection(IndexSectionID id);
+		void writeSection(IndexSectionID id, const void* data, size_t size);
+		void closePSTs();
+
+	public:
+		IndexWriter(const std::string& filename, size_t nrNodes, size_t coordWidth, PSTLayout layout = PST_LAYOUT_HEAP);
+		~IndexWriter();
+		bool good() const;
+		void addPST(size_t mass, const MinMaxPST& pst); // masses in increasing order, before all other sections
+		void writeLeaves(const MinMaxPST& leaves);
+		void writeTrie(const TrieTable& trie);
+		void writeLeafSeqs(const LeafTable& leafSeqs);
+		void writeLastOcc(const std::vector<char>& order, const std::vector<size_t>& table);
+		void writeLinks(const SharedArray<size_t>& offsets, const SharedArray<size_t>& links);
+		void close();	// write mass directory and header
+};
+
+class IndexFile {
+	private:
+		std::shared_ptr<const MappedFile> file;
+		const IndexHeader* header;
+
+	public:
+		IndexFile(const std::string& filename);
+		~IndexFile();
+		static bool isIndexFile(const std::string& filename); // check for binary index magic
+		bool good() const;
+		uint32_t getFlags() const;
+		size_t getNrNodes() const;
+		size_t getCoordWidth() const;
+		PSTLayout getLayout() const;
+		std::shared_ptr<const void> getStorage() const; // keeps the mapping alive
+
+		// pointer to section id and its number of elements
+		template<typename T>
+		const T* getSection(IndexSectionID id, size_t& count) const {
+			count = header->sections[id].size / sizeof(T);	// for coordinates: bytes / getCoordWidth()
+			return reinterpret_cast<const T*>(file->begin() + header->sections[id].offset);
+		}
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <assert.h>
+
+#include "minmaxpst.h"
+#include "massDirectory.h"
+
+//#define DEBUG
+#ifdef DEBUG
+#	define LOG(x) std::clog << "DEBUG: " << x << std::endl;
+#else
+#	define LOG(x) do {} while (0)
+#endif
+
+// largest mass range covered by the lookup table (16 MB of slots)
+const size_t MAX_DENSE_RANGE = 1 << 22;
+
+
+MassDirectory::MassDirectory() : dense(true) {}
+MassDirectory::~MassDirectory() {}
+
+void MassDirectory::add(size_t mass, const MinMaxPST& pst) {
+	assert( masses.empty() || masses.back() < mass );
+	masses.push_back(mass);
+	psts.push_back(pst);
+
+	if (!dense)
+		return;
+	const size_t slot = mass - masses.front();
+	if (slot >= MAX_DENSE_RANGE) {
+		LOG("mass range exceeds " + std::to_string(MAX_DENSE_RANGE) + ", use binary search");
+		dense = false;
+		std::vector<uint32_t>().swap(slots);
+		std::vector<uint64_t>().swap(present);
+		return;
+	}
+	slots.resize(slot+1, 0);
+	slots[slot] = masses.size();
+	present.resize(slot/64+1, 0);
+	present[slot/64] |= uint64_t(1) << (slot%64);
+}
+
+size_t MassDirectory::search(size_t mass) const {
+	if (dense) {
+		if (masses.empty() || mass < masses.front() || mass - masses.front() >= slots.size() || slots[mass - masses.front()] == 0)
+			return masses.size();
+		return slots[mass - masses.front()] - 1;
+	}
+	std::vector<size_t>::const_iterator it = std::lower_bound(masses.begin(), masses.end(), mass);
+	if (it == masses.end() || *it != mass)
+		return masses.size();
+	return it - masses.begin();
+}
+
+const MinMaxPST* MassDirectory::find(size_t mass) const {
+	const size_t i = search(mass);
+	return (i < psts.size()) ? &psts[i] : nullptr;
+}
+
+size_t MassDirectory::lowerBound(size_t mass) const {
+	return std::lower_bound(masses.begin(), masses.end(), mass) - masses.begin();
+}
+
+bool MassDirectory::contains(size_t mass) const {
+	if (dense) {
+		if (masses.empty() || mass < masses.front() || (mass - masses.front())/64 >= present.size())
+			return false;
+		return (present[(mass - masses.front())/64] >> ((mass - masses.front())%64)) & 1;
+	}
+	return search(mass) < masses.size();
+}
+
+bool MassDirectory::containsRange(size_t lo, size_t hi) const {
+	const size_t i = lowerBound(lo);
+	return i < masses.size() && masses[i] <= hi;
+}
+
+size_t MassDirectory::size() const { return masses.size(); }
+bool MassDirectory::empty() const { return masses.empty(); }
+size_t MassDirectory::getMass(size_t i) const { return masses[i]; }
+const MinMaxPST& MassDirectory::getPST(size_t i) const { return psts[i]; }
+const std::vector<size_t>& MassDirectory::getMasses() const { return masses; }
@@ -0,0 +1,41 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef MASSDIRECTORY_H
+#define MASSDIRECTORY_H
+
+#include <vector>
+#include <cstdint>
+
+#include "minmaxpst.h"
+
+// PST of each mass; masses are kept in a sorted array and looked up through a
+// table indexed by mass - smallest mass (binary search if the mass range is too large),
+// with a bitset of the masses that rejects masses without a PST before the table is read
+class MassDirectory {
+	private:
+		std::vector<size_t> masses;		// sorted
+		std::vector<MinMaxPST> psts;	// psts[i] belongs to masses[i]
+		std::vector<uint32_t> slots;	// slots[mass - masses[0]] = i+1, or 0 if there is no PST
+		std::vector<uint64_t> present;	// bit mass - masses[0] is set if there is a PST (as slots, 1/32 of the size)
+		bool dense;
+
+		size_t search(size_t mass) const; // index of mass or size() if not found
+
+	public:
+		MassDirectory();
+		~MassDirectory();
+		void add(size_t mass, const MinMaxPST& pst); // masses in increasing order
+		const MinMaxPST* find(size_t mass) const; // nullptr if there is no PST for mass
+		size_t lowerBound(size_t mass) const; // index of the first mass >= mass, size() if there is none
+		bool contains(size_t mass) const; // find(mass) != nullptr, without touching the PSTs or the slots
+		bool containsRange(size_t lo, size_t hi) const; // a PST for some mass in [lo,hi]
+		size_t size() const;
+		bool empty() const;
+		size_t getMass(size_t i) const;
+		const MinMaxPST& getPST(size_t i) const;
+		const std::vector<size_t>& getMasses() const;
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include <sstream>
 
 #include "minmaxpst.h"
+#include "rangeTree.h"
 
 //#define DEBUG
 #ifdef DEBUG
@@ -24,86 +25,105 @@
 typedef size_t coord_t;
 typedef std::pair<coord_t,coord_t> MinMaxPST_Node;
 
-constexpr size_t floorLog2(size_t n) { return ( (n<2) ? 0 : 1+floorLog2(n/2)); }
-constexpr size_t pow2(size_t n) { return 1 << n; }
+constexpr size_t floorLog2(size_t n) { return ( (n<2) ? 0 : 8*sizeof(unsigned long long)-1-__builtin_clzll(n)); }
+constexpr size_t pow2(size_t n) { return size_t(1) << n; }
 
 
+
+/*
+ * BasicMinMaxPST class implementation
+ */
+
+// blocked layout of the levels of a PST with fullLevels complete levels: the levels above the block of a node
+// are stored completely before it, the blocks of its block level (all with the same height) from left to right,
+// and the nodes of a block in heap order; the partial last level follows in heap order
+const PSTBlockedLevel* getBlockedLevels( size_t fullLevels ) {
+	static const std::vector< std::array<PSTBlockedLevel,64> > table = []() {
+		std::vector< std::array<PSTBlockedLevel,64> > t(65);
+		for ( size_t h = 0; h <= 64; h++ ) {
+			for ( size_t l = 0; l < 64; l++ ) {
+				if (l >= h) {
+					t[h][l] = { size_t(0) - 1, 0, 1, 0 };
+					continue;
+				}
+				const size_t top = l - l % PST_BLOCK_HEIGHT;	// first level of the block
+				const size_t d = l - top;
+				const size_t blockSize = pow2(std::min(PST_BLOCK_HEIGHT, h - top)) - 1;
+				t[h][l] = { (pow2(top) - 1) - pow2(top) * blockSize + (pow2(d) - 1), d, blockSize, pow2(d) - 1 };
+			}
+		}
+		return t;
+	}();
+	return table[fullLevels].data();
+}
+
+template<typename T>
+BasicMinMaxPST<T>::BasicMinMaxPST( const Node* array, size_t size, coord_t pINF, coord_t nINF, PSTLayout l ) : t(array), n(size), posINF(pINF), negINF(nINF),
+	levels( (l == PST_LAYOUT_BLOCKED) ? getBlockedLevels(floorLog2(size+1)) : nullptr ) {}
+
 // 1-based
-const MinMaxPST_Node& MinMaxPST::get(size_t i) const {
-//	assert(i > 0 && i <= t.size());
-	return t.at(i-1); 
+template<typename T>
+const typename BasicMinMaxPST<T>::Node& BasicMinMaxPST<T>::get(size_t i) const {
+//	assert(i > 0 && i <= n);
+	if (levels == nullptr)
+		return t[i-1];
+	const PSTBlockedLevel& l = levels[floorLog2(i)];
+	return t[l.offset + (i >> l.shift) * l.blockSize + (i & l.mask)];
+}
+
+template<typename T>
+void BasicMinMaxPST<T>::prefetch(size_t i) const {
+	if (i <= n)
+		__builtin_prefetch(&get(i));
+}
+
+template<typename T>
+size_t BasicMinMaxPST<T>::blockedPosition( size_t i, size_t size ) {
+	const PSTBlockedLevel& l = getBlockedLevels(floorLog2(size+1))[floorLog2(i)];
+	return l.offset + (i >> l.shift) * l.blockSize + (i & l.mask);
+}
+
+template<typename T>
+void BasicMinMaxPST<T>::toBlocked( std::vector<Node>& a ) {
+	std::vector<Node> b(a.size());
+	for ( size_t i = 1; i <= a.size(); i++ )
+		b[blockedPosition(i, a.size())] = a[i-1];
+	a.swap(b);
 }
 
 // 1-based
-size_t MinMaxPST::smallestYCoordIndex(size_t start, size_t end) const {
-//	assert( start > 0 && end <= t.size());
+template<typename T>
+size_t BasicMinMaxPST<T>::smallestYCoordIndex(const std::vector<Node>& a, size_t start, size_t end) {
+//	assert( start > 0 && end <= a.size());
 	size_t res = start;
 	for ( size_t i = start; i <= end; i++ )
-		res = (get(res).second > get(i).second) ? i : res;
+		res = (a[res-1].second > a[i-1].second) ? i : res;
 	return res;
 }
 
 // 1-based
-size_t MinMaxPST::largestYCoordIndex(size_t start, size_t end) const {
-//	assert( start > 0 && end <= t.size());
+template<typename T>
+size_t BasicMinMaxPST<T>::largestYCoordIndex(const std::vector<Node>& a, size_t start, size_t end) {
+//	assert( start > 0 && end <= a.size());
 	size_t res = start;
 	for ( size_t i = start; i <= end; i++ )
-		res = (get(res).second > get(i).second) ? res : i;
+		res = (a[res-1].second > a[i-1].second) ? res : i;
 	return res;
 }
 
-void MinMaxPST::swap(size_t i, size_t j) {
-//	assert( i > 0 && j > 0 && i <= t.size() && j <= t.size());
-	iter_swap(t.begin() + i-1, t.begin() + j-1);
-}
-
-MinMaxPST::MinMaxPST( const std::string s ) {
-	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
-	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
-	LOG("Deserialization of: " + s);
-	std::string::size_type pos = s.find(':');
-	if (pos == std::string::npos)
-		std::cout << "ERROR in deserialization - size of PST not found." << std::endl;
-	std::stringstream sstream( s.substr(0,pos) );
-	size_t size;
-	sstream >> size;
-	LOG("Reserve: " + s.substr(0,pos) + " entries");
-	t.reserve( size_t(size) );
-
-	assert( s.at(pos+1) == '(' );
-	std::string::size_type start = pos+1;
-	std::string::size_type mid = s.find(',',pos+1);
-	std::string::size_type end = s.find(')',pos+1);
-	MinMaxPST_Node next;
-	size_t first, second;
-	while (end != std::string::npos) {
-		LOG("next point: " + s.substr(start,mid-start) + " , " + s.substr(mid+1, end-mid));
-		std::stringstream s1( s.substr(start+1,mid-start) );
-		s1 >> first;
-		std::stringstream s2( s.substr(mid+1,end-mid) );
-		s2 >> second;
-
-		next = std::make_pair( first, second );
-		t.push_back(next);
-		start = s.find('(',end+1);
-		mid = s.find(',',end+1);
-		end = s.find(')',end+1);
-	}
+template<typename T>
+void BasicMinMaxPST<T>::swap(std::vector<Node>& a, size_t i, size_t j) {
+//	assert( i > 0 && j > 0 && i <= a.size() && j <= a.size());
+	iter_swap(a.begin() + i-1, a.begin() + j-1);
 }
-MinMaxPST::MinMaxPST( const std::vector< MinMaxPST_Node >& points ) {
-
-	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
-	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
 
-	t.resize(points.size());
-	std::copy ( points.begin(), points.end(), t.begin() );
-//	t.reserve(points.size());
-//	std::copy( points.begin(), points.end(), std::back_inserter(t) );
-	const size_t h = floorLog2(points.size());			// tree height
-	const size_t A = t.size() - (pow2(h) - 1);			// nr of leaf nodes
+template<typename T>
+void BasicMinMaxPST<T>::buildBySorting( std::vector<Node>& a ) {
+	const size_t h = floorLog2(a.size());			// tree height
+	const size_t A = a.size() - (pow2(h) - 1);			// nr of leaf nodes
 	
-	// sort t by x coordinate
-	std::sort(t.begin(),t.end());
+	// sort a by x coordinate
+	std::sort(a.begin(),a.end());
 
 	// build levels
 	for ( size_t i = 0; i < h; i++ ) {
@@ -123,12 +143,12 @@ MinMaxPST::MinMaxPST( const std::vector< MinMaxPST_Node >& points ) {
 			// find index with smallest/largest y coordinate
 			size_t l;
 			if ( i % 2 )
-				l = largestYCoordIndex(pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
+				l = largestYCoordIndex(a,pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
 			else
-				l = smallestYCoordIndex(pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
+				l = smallestYCoordIndex(a,pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
 
 			// swap point with smallest/largest y coordinate
-			swap(l,pow2(i) + j - 1);
+			swap(a,l,pow2(i) + j - 1);
 		}
 
 		// for the remaining subtrees: one has size k2, the remaining have size k3
@@ -136,225 +156,671 @@ MinMaxPST::MinMaxPST( const std::vector< MinMaxPST_Node >& points ) {
 		if (k < pow2(i)) {
 			size_t l;
 			if ( i % 2 ) 
-				l = largestYCoordIndex(pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
+				l = largestYCoordIndex(a,pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
 			else
-				l = smallestYCoordIndex(pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
-			swap(l,pow2(i)+k);
+				l = smallestYCoordIndex(a,pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
+			swap(a,l,pow2(i)+k);
 			const size_t m = pow2(i) + k*k1 + k2;
 			for ( size_t j = 1; j < pow2(i)-k; j++ ) {
 				if ( i % 2 ) 
-					l = largestYCoordIndex(m+(j-1)*k3,m+j*k3-1);
+					l = largestYCoordIndex(a,m+(j-1)*k3,m+j*k3-1);
 				else
-					l = smallestYCoordIndex(m+(j-1)*k3,m+j*k3-1);
-				swap(l,pow2(i)+k+j);
+					l = smallestYCoordIndex(a,m+(j-1)*k3,m+j*k3-1);
+				swap(a,l,pow2(i)+k+j);
 			}
 		}
 
 		// finally, sort the remaining array with nodes of levels i+1...h
-		std::sort(t.begin()+pow2(i+1)-1, t.end());
+		std::sort(a.begin()+pow2(i+1)-1, a.end());
 	}
 }
 
-MinMaxPST::~MinMaxPST() {}
-
-void MinMaxPST::printArray() const {
-	for (auto p : t) 
-		std::cout << "(" << p.first << "," << p.second << ") ";
-	std::cout << std::endl;
+// restore the order of a[start..] (0-based), which is sorted except for the nodes at the 1-based positions in moved
+template<typename T>
+void BasicMinMaxPST<T>::merge( std::vector<Node>& a, size_t start, std::vector<size_t>& moved ) {
+	std::sort(moved.begin(), moved.end());
+	moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+	std::vector<Node> m;
+	m.reserve(moved.size());
+	for ( auto p : moved )
+		m.push_back(a[p-1]);
+	std::sort(m.begin(), m.end());
+
+	// shift the sorted nodes to the end, then merge them with m from the front
+	size_t w = a.size();
+	size_t k = moved.size();
+	for ( size_t r = a.size(); r > start; r-- ) {
+		if ( k > 0 && moved[k-1] == r )
+			k--;
+		else
+			a[--w] = a[r-1];
+	}
+	size_t out = start;
+	size_t i = 0;
+	while ( i < m.size() ) {
+		if ( w < a.size() && a[w] < m[i] )
+			a[out++] = a[w++];
+		else
+			a[out++] = m[i++];
+	}
 }
 
-std::vector< MinMaxPST_Node > MinMaxPST::getArray() const { return t; }
+template<typename T>
+void BasicMinMaxPST<T>::build( std::vector<Node>& a ) {
+	const size_t h = floorLog2(a.size());			// tree height
+	const size_t A = a.size() - (pow2(h) - 1);			// nr of leaf nodes
+	
+	// sort a by x coordinate
+	std::sort(a.begin(),a.end());
+
+	// build levels as buildBySorting, but only the nodes swapped behind level i have to be sorted again
+	std::vector<size_t> moved;
+	for ( size_t i = 0; i < h; i++ ) {
+		const size_t k = static_cast<size_t>(std::floor( A/pow2(h-i) )); 
+		const size_t k1 = pow2(h+1-i) - 1;
+		const size_t k2 = pow2(h-i) - 1 + A - k * pow2(h-i);
+		const size_t k3 = pow2(h-i) - 1;
+
+		moved.clear();
+		for ( size_t j = 1; j <= k; j++ ) {
+			size_t l;
+			if ( i % 2 )
+				l = largestYCoordIndex(a,pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
+			else
+				l = smallestYCoordIndex(a,pow2(i) + (j-1)*k1, pow2(i) + j*k1-1);
+			swap(a,l,pow2(i) + j - 1);
+			if ( l >= pow2(i+1) )
+				moved.push_back(l);
+		}
+
+		if (k < pow2(i)) {
+			size_t l;
+			if ( i % 2 ) 
+				l = largestYCoordIndex(a,pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
+			else
+				l = smallestYCoordIndex(a,pow2(i) + k*k1, pow2(i) + k*k1 + k2 - 1);
+			swap(a,l,pow2(i)+k);
+			if ( l >= pow2(i+1) )
+				moved.push_back(l);
+			const size_t m = pow2(i) + k*k1 + k2;
+			for ( size_t j = 1; j < pow2(i)-k; j++ ) {
+				if ( i % 2 ) 
+					l = largestYCoordIndex(a,m+(j-1)*k3,m+j*k3-1);
+				else
+					l = smallestYCoordIndex(a,m+(j-1)*k3,m+j*k3-1);
+				swap(a,l,pow2(i)+k+j);
+				if ( l >= pow2(i+1) )
+					moved.push_back(l);
+			}
+		}
+
+		// the nodes of levels i+1...h are sorted, except for the moved ones
+		merge(a, pow2(i+1)-1, moved);
+	}
+}
 
-bool MinMaxPST::isLeaf(const size_t i) const {
-//	assert(i>0 && i <= t.size());
-	return (2*i > t.size());
+template<typename T>
+bool BasicMinMaxPST<T>::isLeaf(const size_t i) const {
+//	assert(i>0 && i <= n);
+	return (2*i > n);
 }
-size_t MinMaxPST::getLevel(const size_t i) { return floorLog2(i); }
-size_t MinMaxPST::parent(const size_t i) const { return i/2; }
-size_t MinMaxPST::leftChild(const size_t i) const { return 2*i; }
-size_t MinMaxPST::rightChild(const size_t i) const { return 2*i+1; }
-size_t MinMaxPST::nrChildren(const size_t i) const {
-//	assert(i>0 && i <= t.size());
+template<typename T>
+size_t BasicMinMaxPST<T>::getLevel(const size_t i) { return floorLog2(i); }
+template<typename T>
+size_t BasicMinMaxPST<T>::parent(const size_t i) const { return i/2; }
+template<typename T>
+size_t BasicMinMaxPST<T>::leftChild(const size_t i) const { return 2*i; }
+template<typename T>
+size_t BasicMinMaxPST<T>::rightChild(const size_t i) const { return 2*i+1; }
+template<typename T>
+size_t BasicMinMaxPST<T>::nrChildren(const size_t i) const {
+//	assert(i>0 && i <= n);
 	if (isLeaf(i))
 		return 0;
-	else if (leftChild(i) == t.size())
+	else if (leftChild(i) == n)
 		return 1;
 	else {
-		//assert(rightChild(i) <= t.size());
+		//assert(rightChild(i) <= n);
 		return 2;
 	}
 }
-bool MinMaxPST::inNE(const MinMaxPST_Node& o, const MinMaxPST_Node& q) {
-	return o.first <= q.first && o.second <= q.second;
-}
-bool MinMaxPST::inNW(const MinMaxPST_Node& o, const MinMaxPST_Node& q) {
-	return o.first >= q.first && o.second <= q.second;
-}
-bool MinMaxPST::inSE(const MinMaxPST_Node& o, const MinMaxPST_Node& q) {
-	return o.first <= q.first && o.second >= q.second;
-}
-bool MinMaxPST::inSW(const MinMaxPST_Node& o, const MinMaxPST_Node& q) {
-	return o.first >= q.first && o.second >= q.second;
+// orders of the query results: better(p,q) if p comes first; points are compared by x or y coordinate
+struct Leftmost {
+	static const bool onX = true;
+	static const bool max = false;
+	template<class N> static bool better(const N& p, const N& q) { return p.first < q.first; }
+};
+struct Rightmost {
+	static const bool onX = true;
+	static const bool max = true;
+	template<class N> static bool better(const N& p, const N& q) { return p.first > q.first; }
+};
+struct Lowest {
+	static const bool onX = false;
+	static const bool max = false;
+	template<class N> static bool better(const N& p, const N& q) { return p.second < q.second; }
+};
+struct Highest {
+	static const bool onX = false;
+	static const bool max = true;
+	template<class N> static bool better(const N& p, const N& q) { return p.second > q.second; }
+};
+
+// y ranges of the queries: y' >= y (Above) or y' <= y (Below); a subtree has a point in
+// the range iff its largest (Above) or smallest (Below) y coordinate is in the range
+struct Above {
+	static const bool max = true;
+	static bool contains(coord_t v, coord_t y) { return v >= y; }
+};
+struct Below {
+	static const bool max = false;
+	static bool contains(coord_t v, coord_t y) { return v <= y; }
+};
+
+// index of the point with the largest (Max) or smallest y coordinate in the subtree of i,
+// which is its root on max or min levels and otherwise its root or one of its children
+template<typename T>
+template<bool Max>
+size_t BasicMinMaxPST<T>::extremeYIndex(const size_t i) const {
+	if ((getLevel(i) % 2 == 1) == Max)
+		return i;
+	size_t res = i;
+	for (size_t c = 0; c < nrChildren(i); c++) {
+		const size_t child = leftChild(i) + c;
+		if (Max ? get(child).second > get(res).second : get(child).second < get(res).second)
+			res = child;
+	}
+	return res;
 }
-coord_t MinMaxPST::getPosINF() const { return posINF; }
-coord_t MinMaxPST::getNegINF() const { return negINF; }
 
-size_t MinMaxPST::getleftmost(const MinMaxPST_Node& o, const std::array<size_t,4>& next, std::function<bool(const MinMaxPST_Node&, const MinMaxPST_Node&)> inQuadrant, const size_t offset) const {
-	auto it = next.begin() + offset;
-	auto resPointer = next.end();
-	while (it < next.end()) {
-		if ( inQuadrant(o,get(*it)) ||
-			((nrChildren(*it) >= 1) && inQuadrant(o,get(leftChild(*it))) ) ||
-			((nrChildren(*it) == 2) && inQuadrant(o,get(rightChild(*it))) ) ) {
-			if (resPointer != next.end())
-				resPointer = (get(*resPointer).first > get(*it).first) ? it : resPointer;
+// split the points with x0 <= x <= x1 into whole subtrees (inside) and single nodes on at most four
+// paths (boundary) whose own points have to be checked. The subtrees of a level are ordered by x, so
+// only those next to the first point with x >= x0 and the last point with x <= x1 can cross a bound.
+template<typename T>
+void BasicMinMaxPST<T>::splitX(coord_t x0, coord_t x1, XSplit& split) const {
+	split.nrInside = 0;
+	split.nrBoundary = 0;
+	if (n == 0 || x0 > x1)
+		return;
+	std::array<size_t,4> level = {{ 1 }};
+	std::array<size_t,8> children;
+	size_t nrLevel = 1;
+	while (nrLevel > 0) {
+		size_t nrChildrenOfLevel = 0;
+		for (size_t l = 0; l < nrLevel; l++) {
+			split.boundary[split.nrBoundary++] = level[l];
+			for (size_t c = 0; c < nrChildren(level[l]); c++)
+				children[nrChildrenOfLevel++] = leftChild(level[l]) + c;
+		}
+		nrLevel = 0;
+
+		// 1-based: children before j-1 are left of x0, children after k+1 right of x1,
+		// without a bound (x0 = 0 or x1 = max) no child can cross it
+		size_t j = 0;	// first child with x >= x0
+		if (x0 > std::numeric_limits<coord_t>::min()) {
+			j = 1;
+			while (j <= nrChildrenOfLevel && get(children[j-1]).first < x0)
+				j++;
+		}
+		size_t k = nrChildrenOfLevel + 1;	// last child with x <= x1
+		if (x1 < std::numeric_limits<coord_t>::max()) {
+			k = nrChildrenOfLevel;
+			while (k > 0 && get(children[k-1]).first > x1)
+				k--;
+		}
+		for (size_t c = 1; c <= nrChildrenOfLevel; c++) {
+			if (c+1 < j || c > k+1)
+				continue;
+			if (c > j && c < k)
+				split.inside[split.nrInside++] = children[c-1];
 			else
-				resPointer = it;
+				level[nrLevel++] = children[c-1];
 		}
-		it++;
+		for (size_t l = 0; l < nrLevel; l++)
+			prefetch(leftChild(level[l]));
 	}
-	if (resPointer == next.end()) 
-		resPointer = next.begin() + offset;
-	return *resPointer;
-}
-
-MinMaxPST_Node MinMaxPST::leftmostNE(const MinMaxPST_Node& o) const { 
-	MinMaxPST_Node best = std::make_pair(posINF,posINF);
-	size_t p = 1;
-	size_t q = 1;
-
-	while ( !isLeaf(p) ) {
-		//assert( p <= q );
-
-		// update best
-		best = (inNE(o,get(p)) && best.first > get(p).first) ? get(p) : best;
-		best = (inNE(o,get(q)) && best.first > get(q).first) ? get(q) : best;
-
-		if (p == q) {
-			q = (nrChildren(p) == 1) ? leftChild(p) : rightChild(p);
-			p = leftChild(p);
-		} else {
-			if (isLeaf(q))
-				q = p;
-			else if (nrChildren(q) == 1) {
-				if ( get(leftChild(q)).first < o.first ) {
-					p = leftChild(q);
-					q = leftChild(q);
-				} else if ( get(rightChild(p)).first < o.first ) {
-					p = rightChild(p);
-					q = leftChild(q);
-				} else {
-					q = rightChild(p);
-					p = leftChild(p);
-				}
-			} else {
-				// next is sorted by x-coordinate
-				const std::array<size_t,4> next = { 
-					leftChild(p), rightChild(p), 
-					leftChild(q), rightChild(q) 
-				};
-
-				if (o.first < get(leftChild(p)).first) {
-					p = q = getleftmost(o,next,inNE);
-				} else if (o.first >= get(rightChild(q)).first) {
-					p = q = rightChild(q);
-				} else {
-					size_t i;
-					if ( get(leftChild(p)).first <= o.first && o.first < get(rightChild(p)).first )
-						i = 0;
-					else if ( get(rightChild(p)).first <= o.first && o.first < get(leftChild(q)).first )
-						i = 1;
-					else if ( get(leftChild(q)).first <= o.first && o.first < get(rightChild(q)).first )
-						i = 2;
-					else
-						i = 3;
-					p = next.at(i);
-					q = getleftmost(o,next,inNE,i);
-				}
-			}
-		}
+}
+
+// best point by Order among the points with x0 <= x <= x1 and y' in YRange, nullptr if there is none.
+// Orders by y have to look for the extreme of the y range (highest above, lowest below y), so that the
+// best point of a whole subtree is found at its root or children. Orders by x descend into the outermost
+// whole subtree with a point in the y range, preferring the child on that side.
+template<typename T>
+template<class Order, class YRange>
+const typename BasicMinMaxPST<T>::Node* BasicMinMaxPST<T>::best(coord_t x0, coord_t x1, coord_t y) const {
+	static_assert(Order::onX || Order::max == YRange::max, "no logarithmic query for the point of a y range nearest to y");
+	const Node* res = nullptr;
+	if (n <= PST_SCAN_SIZE) {
+		for (size_t k = 0; k < n; k++)
+			if (x0 <= t[k].first && t[k].first <= x1 && YRange::contains(t[k].second, y) && (res == nullptr || Order::better(t[k], *res)))
+				res = &t[k];
+		return res;
 	}
 
-	// update best
-	best = (inNE(o,get(p)) && best.first > get(p).first) ? get(p) : best;
-	best = (inNE(o,get(q)) && best.first > get(q).first) ? get(q) : best;
-	return best;
-};
-MinMaxPST_Node MinMaxPST::leftmostSE(const MinMaxPST_Node& o) const { 
-	MinMaxPST_Node best = std::make_pair(posINF,negINF);
-	size_t p = 1;
-	size_t q = 1;
-
-	while ( !isLeaf(p) ) {
-		//assert( p <= q );
-		// update best
-		best = (inSE(o,get(p)) && best.first > get(p).first) ? get(p) : best;
-		best = (inSE(o,get(q)) && best.first > get(q).first) ? get(q) : best;
-
-		if (p == q) {
-			q = (nrChildren(p) == 1) ? leftChild(p) : rightChild(p);
-			p = leftChild(p);
-		} else {
-			if (isLeaf(q))
-				q = p;
-			else if (nrChildren(q) == 1) {
-				if ( get(leftChild(q)).first < o.first ) {
-					p = leftChild(q);
-					q = leftChild(q);
-				} else if ( get(rightChild(p)).first < o.first ) {
-					p = rightChild(p);
-					q = leftChild(q);
-				} else {
-					q = rightChild(p);
-					p = leftChild(p);
-				}
-			} else {
-				// next is sorted by x-coordinate
-				const std::array<size_t,4> next = { 
-					leftChild(p), rightChild(p), 
-					leftChild(q), rightChild(q) 
-				};
-
-				if (o.first < get(leftChild(p)).first) {
-					p = q = getleftmost(o,next,inSE);
-				} else if (o.first >= get(rightChild(q)).first) {
-					p = q = rightChild(q);
-				} else {
-					size_t i;
-					if ( get(leftChild(p)).first <= o.first && o.first < get(rightChild(p)).first )
-						i = 0;
-					else if ( get(rightChild(p)).first <= o.first && o.first < get(leftChild(q)).first )
-						i = 1;
-					else if ( get(leftChild(q)).first <= o.first && o.first < get(rightChild(q)).first )
-						i = 2;
-					else
-						i = 3;
-					p = next.at(i);
-					q = getleftmost(o,next,inSE,i);
-				}
-			}
+	XSplit split;
+	splitX(x0, x1, split);
+
+	for (size_t b = 0; b < split.nrBoundary; b++) {
+		const Node& p = get(split.boundary[b]);
+		if (x0 <= p.first && p.first <= x1 && YRange::contains(p.second, y) && (res == nullptr || Order::better(p, *res)))
+			res = &p;
+	}
+
+	if (!Order::onX) {
+		for (size_t b = 0; b < split.nrInside; b++) {
+			const Node& p = get(extremeYIndex<YRange::max>(split.inside[b]));
+			if (YRange::contains(p.second, y) && (res == nullptr || Order::better(p, *res)))
+				res = &p;
 		}
+		return res;
 	}
 
-	// update best
-	best = (inSE(o,get(p)) && best.first > get(p).first) ? get(p) : best;
-	best = (inSE(o,get(q)) && best.first > get(q).first) ? get(q) : best;
-	return best;
-};
+	size_t r = 0;
+	for (size_t b = 0; b < split.nrInside; b++) {
+		// the subtrees are disjoint in x, so their roots give their order; deeper ones are nearer to the bounds
+		const size_t i = split.inside[Order::max ? b : split.nrInside-1-b];
+		if ((r == 0 || Order::better(get(i), get(r))) && YRange::contains(get(extremeYIndex<YRange::max>(i)).second, y))
+			r = i;
+	}
+	while (r != 0) {
+		if (YRange::contains(get(r).second, y) && (res == nullptr || Order::better(get(r), *res)))
+			res = &get(r);
+		const size_t first = (!Order::max || nrChildren(r) == 1) ? leftChild(r) : rightChild(r);
+		const size_t second = Order::max ? leftChild(r) : rightChild(r);
+		if (nrChildren(r) >= 1 && YRange::contains(get(extremeYIndex<YRange::max>(first)).second, y))
+			r = first;
+		else if (nrChildren(r) == 2 && YRange::contains(get(extremeYIndex<YRange::max>(second)).second, y))
+			r = second;
+		else
+			r = 0;
+	}
+	return res;
+}
 
-MinMaxPST_Node MinMaxPST::rightmostNW(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::highestNE(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::highestNW(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::rightmostSW(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::lowestSE(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::lowestSW(const MinMaxPST_Node& o) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::lowest3SideUp(coord_t x1, coord_t x2, coord_t y) const { return std::make_pair(0,0); };
-MinMaxPST_Node MinMaxPST::highest3SideDown(coord_t x1, coord_t x2, coord_t y) const { return std::make_pair(0,0); };
-std::vector< MinMaxPST_Node > MinMaxPST::enumerateUp(coord_t x1, coord_t x2, coord_t y) const { return std::vector< MinMaxPST_Node >(); };
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::leftmostNE(const MinMaxPST_Node& o) const {
+	const Node* p = best<Leftmost,Above>(o.first, posINF, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::leftmostSE(const MinMaxPST_Node& o) const {
+	const Node* p = best<Leftmost,Below>(o.first, posINF, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::rightmostNW(const MinMaxPST_Node& o) const {
+	const Node* p = best<Rightmost,Above>(negINF, o.first, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(negINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::rightmostSW(const MinMaxPST_Node& o) const {
+	const Node* p = best<Rightmost,Below>(negINF, o.first, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(negINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::highestNE(const MinMaxPST_Node& o) const {
+	const Node* p = best<Highest,Above>(o.first, posINF, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::highestNW(const MinMaxPST_Node& o) const {
+	const Node* p = best<Highest,Above>(negINF, o.first, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(negINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::lowestSE(const MinMaxPST_Node& o) const {
+	const Node* p = best<Lowest,Below>(o.first, posINF, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::lowestSW(const MinMaxPST_Node& o) const {
+	const Node* p = best<Lowest,Below>(negINF, o.first, o.second);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(negINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::lowest3SideUp(coord_t x0, coord_t x1, coord_t y) const {
+	const Node* p = best<Lowest,Below>(x0, x1, y);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicMinMaxPST<T>::highest3SideDown(coord_t x0, coord_t x1, coord_t y) const {
+	const Node* p = best<Highest,Above>(x0, x1, y);
+	return (p != nullptr) ? MinMaxPST_Node(*p) : std::make_pair(posINF,posINF);
+}
+
+// report the points with x0 <= x <= x1 and y' in YRange, sorted by x coordinate.
+// A subtree is skipped if its root is on a min level (Below) or max level (Above) and not in the y range,
+// or if its x range, bounded by the x coordinates of the neighbouring children, does not intersect [x0,x1].
+// Every visited node is reported or the child of a reported node, apart from O(log^2 n) nodes at the x boundaries.
+template<typename T>
+template<class YRange>
+std::vector< MinMaxPST_Node > BasicMinMaxPST<T>::enumerate(coord_t x0, coord_t x1, coord_t y) const {
+	std::vector< MinMaxPST_Node > res;
+	if (n == 0 || x0 > x1)
+		return res;
+	if (n <= PST_SCAN_SIZE) {
+		for (size_t k = 0; k < n; k++)
+			if (x0 <= t[k].first && t[k].first <= x1 && YRange::contains(t[k].second, y))
+				res.push_back( MinMaxPST_Node(t[k]) );
+		std::sort(res.begin(), res.end());
+		return res;
+	}
+
+	struct Subtree {
+		size_t i;
+		size_t level;
+		coord_t lo;		// all x coordinates in the subtree are in [lo,hi]
+		coord_t hi;
+	};
+	std::vector<Subtree> stack;
+	stack.push_back( { 1, 0, std::numeric_limits<coord_t>::min(), std::numeric_limits<coord_t>::max() } );
+	while (!stack.empty()) {
+		const Subtree s = stack.back();
+		stack.pop_back();
+		const Node& p = get(s.i);
+		const bool inY = YRange::contains(p.second, y);
+		if (inY && x0 <= p.first && p.first <= x1)
+			res.push_back( MinMaxPST_Node(p) );
+		if (!inY && (s.level % 2 == 1) == YRange::max)
+			continue;
+		if (nrChildren(s.i) == 0)
+			continue;
+
+		// the x coordinates of the left subtree are smaller than those of the right subtree
+		const size_t l = leftChild(s.i);
+		const size_t r = rightChild(s.i);
+		const coord_t lhi = (nrChildren(s.i) == 2) ? get(r).first - 1 : s.hi;
+		if (nrChildren(s.i) == 2 && s.hi >= x0 && get(l).first + 1 <= x1)
+			stack.push_back( { r, s.level+1, get(l).first + 1, s.hi } );
+		if (lhi >= x0 && s.lo <= x1)
+			stack.push_back( { l, s.level+1, s.lo, lhi } );
+	}
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+// visit the subtree of i (with all x coordinates <= hi) for the queries active[begin..end), sorted by x.
+// The queries that are still active below i are written to active[free..], where both children share them,
+// so that the upper levels of the tree are visited once for the whole batch.
+template<typename T>
+void BasicMinMaxPST<T>::enumerateUp(size_t i, size_t level, coord_t hi, const std::vector< MinMaxPST_Node >& queries,
+									std::vector<size_t>& active, size_t begin, size_t end, size_t free,
+									std::vector< std::vector< MinMaxPST_Node > >& res) const {
+	const Node& p = get(i);
+	const bool minLevel = (level % 2 == 0);
+	if (active.size() < free + (end - begin))
+		active.resize( free + (end - begin) );
+	size_t last = free;
+	for (size_t a = begin; a < end; a++) {
+		const size_t q = active[a];
+		const bool inY = (p.second <= queries[q].second);
+		if (inY && queries[q].first <= p.first)
+			res[q].push_back( MinMaxPST_Node(p) );
+		// on min levels no point below i is in the y range of q if i is not
+		if (inY || !minLevel)
+			active[last++] = q;
+	}
+	if (last == free || nrChildren(i) == 0)
+		return;
+
+	// the left subtree has all x coordinates < x of the right child, and only a prefix of the queries starts there
+	const size_t l = leftChild(i);
+	if (nrChildren(i) == 2) {
+		const coord_t lhi = get(rightChild(i)).first - 1;
+		size_t lend = free;
+		while (lend < last && queries[active[lend]].first <= lhi)
+			lend++;
+		if (lend > free)
+			enumerateUp(l, level+1, lhi, queries, active, free, lend, last, res);
+		enumerateUp(rightChild(i), level+1, hi, queries, active, free, last, last, res);
+	} else {
+		enumerateUp(l, level+1, hi, queries, active, free, last, last, res);
+	}
+}
+
+template<typename T>
+std::vector< std::vector< MinMaxPST_Node > > BasicMinMaxPST<T>::enumerateUp(const std::vector< MinMaxPST_Node >& queries) const {
+	std::vector< std::vector< MinMaxPST_Node > > res(queries.size());
+	if (n == 0 || queries.empty())
+		return res;
+	if (n <= PST_SCAN_SIZE || queries.size() == 1) {
+		for (size_t q = 0; q < queries.size(); q++)
+			res[q] = enumerate<Below>(queries[q].first, std::numeric_limits<coord_t>::max(), queries[q].second);
+		return res;
+	}
+	std::vector<size_t> active(queries.size());
+	for (size_t q = 0; q < queries.size(); q++)
+		active[q] = q;
+	std::stable_sort(active.begin(), active.end(), [&](size_t a, size_t b) { return queries[a].first < queries[b].first; });
+	enumerateUp(1, 0, std::numeric_limits<coord_t>::max(), queries, active, 0, queries.size(), queries.size(), res);
+	for (auto& r : res)
+		std::sort(r.begin(), r.end());
+	return res;
+}
+
+template<typename T>
+std::vector< MinMaxPST_Node > BasicMinMaxPST<T>::enumerateUp(coord_t x0, coord_t x1, coord_t y) const { return enumerate<Below>(x0, x1, y); }
+template<typename T>
+std::vector< MinMaxPST_Node > BasicMinMaxPST<T>::enumerateDown(coord_t x0, coord_t x1, coord_t y) const { return enumerate<Above>(x0, x1, y); }
+
+
+template class BasicMinMaxPST<uint32_t>;
+template class BasicMinMaxPST<uint64_t>;
+
+
+/*
+ * MinMaxPST class implementation
+ */
+
+template<typename T>
+BasicMinMaxPST<T> MinMaxPST::view() const {
+	return BasicMinMaxPST<T>( static_cast<const typename BasicMinMaxPST<T>::Node*>(nodes), n, posINF, negINF, layout );
+}
+
+template<typename T>
+BasicRangeTree<T> MinMaxPST::tree() const {
+	return BasicRangeTree<T>( static_cast<const typename BasicRangeTree<T>::Node*>(nodes), n, posINF, negINF );
+}
+
+template<typename T>
+void MinMaxPST::assign( std::vector< typename BasicMinMaxPST<T>::Node >&& a, size_t size ) {
+	std::shared_ptr< std::vector< typename BasicMinMaxPST<T>::Node > > owned = std::make_shared< std::vector< typename BasicMinMaxPST<T>::Node > >( std::move(a) );
+	nodes = owned->data();
+	n = size;
+	width = sizeof(T);
+	storage = owned;
+}
+
+template<typename T>
+void MinMaxPST::build( const MinMaxPST_Node* first, const MinMaxPST_Node* last ) {
+	std::vector< typename BasicMinMaxPST<T>::Node > a;
+	a.reserve(last - first);
+	for ( const MinMaxPST_Node* p = first; p != last; p++ ) {
+		assert( p->first <= std::numeric_limits<T>::max() && p->second <= std::numeric_limits<T>::max() );
+		a.push_back( typename BasicMinMaxPST<T>::Node( p->first, p->second ) );
+	}
+	const size_t size = a.size();
+	if (layout == PST_LAYOUT_RANGE_TREE) {
+		BasicRangeTree<T>::build(a);
+		assign<T>( std::move(a), size );
+		return;
+	}
+	BasicMinMaxPST<T>::build(a);
+	if (layout == PST_LAYOUT_BLOCKED)
+		BasicMinMaxPST<T>::toBlocked(a);
+	assign<T>( std::move(a), size );
+}
+
+MinMaxPST::MinMaxPST( const std::string s ) : layout(PST_LAYOUT_HEAP) {
+	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
+	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
+	LOG("Deserialization of: " + s);
+	std::string::size_type pos = s.find(':');
+	if (pos == std::string::npos)
+		std::cout << "ERROR in deserialization - size of PST not found." << std::endl;
+	std::stringstream sstream( s.substr(0,pos) );
+	size_t size;
+	sstream >> size;
+	LOG("Reserve: " + s.substr(0,pos) + " entries");
+	std::vector< BasicMinMaxPST<coord_t>::Node > a;
+	a.reserve( size_t(size) );
+
+	assert( s.at(pos+1) == '(' );
+	std::string::size_type start = pos+1;
+	std::string::size_type mid = s.find(',',pos+1);
+	std::string::size_type end = s.find(')',pos+1);
+	MinMaxPST_Node next;
+	size_t first, second;
+	while (end != std::string::npos) {
+		LOG("next point: " + s.substr(start,mid-start) + " , " + s.substr(mid+1, end-mid));
+		std::stringstream s1( s.substr(start+1,mid-start) );
+		s1 >> first;
+		std::stringstream s2( s.substr(mid+1,end-mid) );
+		s2 >> second;
+
+		next = std::make_pair( first, second );
+		a.push_back(next);
+		start = s.find('(',end+1);
+		mid = s.find(',',end+1);
+		end = s.find(')',end+1);
+	}
+	const size_t nrPoints = a.size();
+	assign<coord_t>( std::move(a), nrPoints );
+}
+
+MinMaxPST::MinMaxPST() : nodes(nullptr), n(0), width(sizeof(coord_t)), layout(PST_LAYOUT_HEAP) {
+	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
+	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
+}
+
+MinMaxPST::MinMaxPST( const std::vector< MinMaxPST_Node >& points, size_t w, PSTLayout l ) : MinMaxPST( points.data(), points.data() + points.size(), w, l ) {}
+
+MinMaxPST::MinMaxPST( const MinMaxPST_Node* first, const MinMaxPST_Node* last, size_t w, PSTLayout l ) : layout(l) {
+	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
+	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
+
+	if (w == sizeof(uint32_t))
+		build<uint32_t>(first, last);
+	else
+		build<uint64_t>(first, last);
+}
+
+MinMaxPST::MinMaxPST( const void* array, size_t size, size_t w, std::shared_ptr<const void> s, PSTLayout l ) : nodes(array), n(size), width(w), layout(l), storage(s) {
+	assert( width == sizeof(uint32_t) || width == sizeof(uint64_t) );
+	posINF = std::numeric_limits<coord_t>::has_infinity ? std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::max();
+	negINF = std::numeric_limits<coord_t>::has_infinity ? -std::numeric_limits<coord_t>::infinity() : std::numeric_limits<coord_t>::min();
+}
+
+MinMaxPST::~MinMaxPST() {}
+
+size_t MinMaxPST::narrowestWidth( coord_t maxCoord ) {
+	return (maxCoord <= std::numeric_limits<uint32_t>::max()) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+size_t MinMaxPST::arraySize( size_t size, PSTLayout layout ) {
+	return (layout == PST_LAYOUT_RANGE_TREE) ? BasicRangeTree<uint32_t>::arraySize(size) : size;
+}
+
+size_t MinMaxPST::sizeOfArray( size_t nodes, PSTLayout layout ) {
+	return (layout == PST_LAYOUT_RANGE_TREE) ? BasicRangeTree<uint32_t>::sizeOfArray(nodes) : nodes;
+}
+
+void MinMaxPST::printArray() const {
+	for (auto p : getArray()) 
+		std::cout << "(" << p.first << "," << p.second << ") ";
+	std::cout << std::endl;
+}
+
+std::vector< MinMaxPST_Node > MinMaxPST::getArray() const {
+	std::vector< MinMaxPST_Node > res;
+	res.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		const size_t pos = (layout != PST_LAYOUT_BLOCKED) ? i : BasicMinMaxPST<uint32_t>::blockedPosition(i+1, n);
+		if (width == sizeof(uint32_t))
+			res.push_back( MinMaxPST_Node( static_cast<const BasicMinMaxPST<uint32_t>::Node*>(nodes)[pos] ) );
+		else
+			res.push_back( MinMaxPST_Node( static_cast<const BasicMinMaxPST<uint64_t>::Node*>(nodes)[pos] ) );
+	}
+	return res;
+}
+
+const void* MinMaxPST::data() const { return nodes; }
+size_t MinMaxPST::size() const { return n; }
+size_t MinMaxPST::getWidth() const { return width; }
+PSTLayout MinMaxPST::getLayout() const { return layout; }
+coord_t MinMaxPST::getPosINF() const { return posINF; }
+coord_t MinMaxPST::getNegINF() const { return negINF; }
+
+MinMaxPST_Node MinMaxPST::leftmostNE(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().leftmostNE(o) : tree<uint64_t>().leftmostNE(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().leftmostNE(o) : view<uint64_t>().leftmostNE(o);
+}
+MinMaxPST_Node MinMaxPST::rightmostNW(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().rightmostNW(o) : tree<uint64_t>().rightmostNW(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().rightmostNW(o) : view<uint64_t>().rightmostNW(o);
+}
+MinMaxPST_Node MinMaxPST::highestNE(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().highestNE(o) : tree<uint64_t>().highestNE(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().highestNE(o) : view<uint64_t>().highestNE(o);
+}
+MinMaxPST_Node MinMaxPST::highestNW(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().highestNW(o) : tree<uint64_t>().highestNW(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().highestNW(o) : view<uint64_t>().highestNW(o);
+}
+MinMaxPST_Node MinMaxPST::leftmostSE(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().leftmostSE(o) : tree<uint64_t>().leftmostSE(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().leftmostSE(o) : view<uint64_t>().leftmostSE(o);
+}
+MinMaxPST_Node MinMaxPST::rightmostSW(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().rightmostSW(o) : tree<uint64_t>().rightmostSW(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().rightmostSW(o) : view<uint64_t>().rightmostSW(o);
+}
+MinMaxPST_Node MinMaxPST::lowestSE(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().lowestSE(o) : tree<uint64_t>().lowestSE(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().lowestSE(o) : view<uint64_t>().lowestSE(o);
+}
+MinMaxPST_Node MinMaxPST::lowestSW(const MinMaxPST_Node& o) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().lowestSW(o) : tree<uint64_t>().lowestSW(o);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().lowestSW(o) : view<uint64_t>().lowestSW(o);
+}
+MinMaxPST_Node MinMaxPST::lowest3SideUp(coord_t x1, coord_t x2, coord_t y) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().lowest3SideUp(x1,x2,y) : tree<uint64_t>().lowest3SideUp(x1,x2,y);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().lowest3SideUp(x1,x2,y) : view<uint64_t>().lowest3SideUp(x1,x2,y);
+}
+MinMaxPST_Node MinMaxPST::highest3SideDown(coord_t x1, coord_t x2, coord_t y) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().highest3SideDown(x1,x2,y) : tree<uint64_t>().highest3SideDown(x1,x2,y);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().highest3SideDown(x1,x2,y) : view<uint64_t>().highest3SideDown(x1,x2,y);
+}
+std::vector< MinMaxPST_Node > MinMaxPST::enumerateUp(coord_t x1, coord_t x2, coord_t y) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().enumerateUp(x1,x2,y) : tree<uint64_t>().enumerateUp(x1,x2,y);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().enumerateUp(x1,x2,y) : view<uint64_t>().enumerateUp(x1,x2,y);
+}
+std::vector< MinMaxPST_Node > MinMaxPST::enumerateDown(coord_t x1, coord_t x2, coord_t y) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().enumerateDown(x1,x2,y) : tree<uint64_t>().enumerateDown(x1,x2,y);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().enumerateDown(x1,x2,y) : view<uint64_t>().enumerateDown(x1,x2,y);
+}
+std::vector< std::vector< MinMaxPST_Node > > MinMaxPST::enumerateUp(const std::vector< MinMaxPST_Node >& queries) const {
+	if (layout == PST_LAYOUT_RANGE_TREE)
+		return (width == sizeof(uint32_t)) ? tree<uint32_t>().enumerateUp(queries) : tree<uint64_t>().enumerateUp(queries);
+	return (width == sizeof(uint32_t)) ? view<uint32_t>().enumerateUp(queries) : view<uint64_t>().enumerateUp(queries);
+}
 
+// the text format holds the nodes in heap order, so the points of a range tree are arranged as a PST first
 std::string MinMaxPST::serialize() const {
-	std::string res = std::to_string(t.size()) + ":";
-	for (auto n : t)
+	std::string res = std::to_string(n) + ":";
+	for (auto n : (layout == PST_LAYOUT_RANGE_TREE) ? MinMaxPST(getArray()).getArray() : getArray())
 		res += "(" + std::to_string(n.first) + "," + std::to_string(n.second) + ")";
 	return res;
 }
@@ -7,40 +7,141 @@
 
 #include <vector>
 #include <functional>
+#include <array>
+#include <memory>
+#include <string>
+#include <cstdint>
 
 typedef size_t coord_t;
 typedef std::pair<coord_t,coord_t> MinMaxPST_Node;
 
-class MinMaxPST {
+// physical order of the nodes: BFS heap order, or the complete levels cut into subtrees of
+// PST_BLOCK_HEIGHT levels stored one after another, followed by the last level in heap order;
+// or no PST, but the points sorted by x followed by a range tree that answers the same queries (see rangeTree.h)
+enum PSTLayout { PST_LAYOUT_HEAP = 0, PST_LAYOUT_BLOCKED = 1, PST_LAYOUT_RANGE_TREE = 2 };
+const size_t PST_BLOCK_HEIGHT = 4;
+
+// queries on PSTs with at most PST_SCAN_SIZE points scan the array instead of descending the tree
+#ifndef PST_SCAN_SIZE
+#define PST_SCAN_SIZE 64
+#endif
+
+// the blocked layout stores heap index i on level l at offset + (i >> shift) * blockSize + (i & mask)
+struct PSTBlockedLevel {
+	size_t offset;
+	size_t shift;
+	size_t blockSize;
+	size_t mask;
+};
+
+// min-max priority search tree over points with coordinates of type T, stored in PST order
+// in external memory; the queries take and return points with coord_t coordinates
+template<typename T>
+class BasicMinMaxPST {
+	public:
+		typedef std::pair<T,T> Node;
+
 	private:
-		std::vector<MinMaxPST_Node> t;
+		const Node* t;
+		size_t n;
 		coord_t posINF;		// positive infinity
 		coord_t negINF;		// negative infinity
+		const PSTBlockedLevel* levels;	// per level, nullptr for the heap layout
 
-		const MinMaxPST_Node& get(size_t index) const; // return entry for 1-base indexing
-		size_t smallestYCoordIndex(size_t start, size_t end) const;
-		size_t largestYCoordIndex(size_t start, size_t end) const;
-		void swap(size_t i, size_t j);
+		const Node& get(size_t index) const; // return entry for 1-base indexing
+		void prefetch(size_t index) const;
+		static size_t smallestYCoordIndex(const std::vector<Node>& a, size_t start, size_t end);
+		static size_t largestYCoordIndex(const std::vector<Node>& a, size_t start, size_t end);
+		static void swap(std::vector<Node>& a, size_t i, size_t j);
+		static void merge(std::vector<Node>& a, size_t start, std::vector<size_t>& moved);
 		bool isLeaf(const size_t i) const;
 		size_t leftChild(const size_t i) const;
 		size_t rightChild(const size_t i) const;
 		size_t parent(const size_t i) const;
 		size_t nrChildren(const size_t i) const;
 
-		static bool inNE(const MinMaxPST_Node& o, const MinMaxPST_Node& q);
-		static bool inSE(const MinMaxPST_Node& o, const MinMaxPST_Node& q);
-		static bool inNW(const MinMaxPST_Node& o, const MinMaxPST_Node& q);
-		static bool inSW(const MinMaxPST_Node& o, const MinMaxPST_Node& q);
 		static size_t getLevel(const size_t i);
-		size_t getleftmost(const MinMaxPST_Node& o, const std::array<size_t,4>& next, std::function<bool(const MinMaxPST_Node&, const MinMaxPST_Node&)> inQuadrant, const size_t offset=0) const;
+
+		// query kernels, specialized at compile time for an order of the points and a y range (see minmaxpst.cpp)
+		template<class YRange> std::vector< MinMaxPST_Node > enumerate(coord_t x0, coord_t x1, coord_t y) const;
+		template<bool Max> size_t extremeYIndex(const size_t i) const;
+		// subtrees with all points in an x range and the nodes on its boundary paths (at most 4 per level)
+		struct XSplit {
+			std::array<size_t, 8*64> inside;
+			std::array<size_t, 4*64> boundary;
+			size_t nrInside;
+			size_t nrBoundary;
+		};
+		void splitX(coord_t x0, coord_t x1, XSplit& split) const;
+		template<class Order, class YRange> const Node* best(coord_t x0, coord_t x1, coord_t y) const;
+		void enumerateUp(size_t i, size_t level, coord_t hi, const std::vector< MinMaxPST_Node >& queries,
+						 std::vector<size_t>& active, size_t begin, size_t end, size_t free,
+						 std::vector< std::vector< MinMaxPST_Node > >& res) const;
+
+	public:
+		BasicMinMaxPST( const Node* array, size_t size, coord_t posINF, coord_t negINF, PSTLayout layout = PST_LAYOUT_HEAP );
+		static void build( std::vector<Node>& a );	// arrange points in PST order, O(n log n)
+		static void buildBySorting( std::vector<Node>& a );	// same order, sorting the remaining points at each level, O(n log^2 n)
+		static size_t blockedPosition( size_t index, size_t size );	// 0-based position of a 1-based heap index in the blocked layout
+		static void toBlocked( std::vector<Node>& a );	// rearrange PST order from heap to blocked layout
+		// queries for the point in a quadrant (NE: x >= p.x, y >= p.y, SW: x <= p.x, y <= p.y, ...) or a three-sided
+		// range bounded by y from above (Up: y' <= y) or below (Down: y' >= y); all in O(log n) except the enumerations.
+		// An empty range gives the corner at infinity of the quadrant (the range with x at posINF, resp.)
+		MinMaxPST_Node leftmostNE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node rightmostNW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node highestNE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node highestNW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node leftmostSE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node rightmostSW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowestSE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowestSW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowest3SideUp(coord_t x0, coord_t x1, coord_t y) const;	// lowest point in [x0,x1] x [0,y]
+		MinMaxPST_Node highest3SideDown(coord_t x0, coord_t x1, coord_t y) const;	// highest point in [x0,x1] x [y,inf)
+		std::vector< MinMaxPST_Node > enumerateUp(coord_t x0, coord_t x1, coord_t y) const;	// points in [x0,x1] x [0,y], sorted by x
+		std::vector< MinMaxPST_Node > enumerateDown(coord_t x0, coord_t x1, coord_t y) const;	// points in [x0,x1] x [y,inf), sorted by x
+		// points in [q.x,inf) x [0,q.y] for each query point q, sorted by x; all queries in one traversal.
+		// The ranges of a query point and one to its lower right overlap, so their points are reported for both
+		std::vector< std::vector< MinMaxPST_Node > > enumerateUp(const std::vector< MinMaxPST_Node >& queries) const;
+};
+
+template<typename T> class BasicRangeTree;
+
+// min-max priority search tree with 32 or 64 bit coordinates (width in bytes), either
+// owning its nodes or a view of nodes in external memory (e.g. a mapped index file);
+// with PST_LAYOUT_RANGE_TREE, the queries are answered by a BasicRangeTree instead
+class MinMaxPST {
+	private:
+		const void* nodes;		// BasicMinMaxPST<T>::Node[] in PST order, or the array of a BasicRangeTree<T>
+		size_t n;				// nr of points
+		size_t width;			// sizeof(T)
+		PSTLayout layout;
+		std::shared_ptr<const void> storage;	// keeps nodes alive
+		coord_t posINF;		// positive infinity
+		coord_t negINF;		// negative infinity
+
+		template<typename T> BasicMinMaxPST<T> view() const;
+		template<typename T> BasicRangeTree<T> tree() const;
+		template<typename T> void assign( std::vector< typename BasicMinMaxPST<T>::Node >&& a, size_t size );
+		template<typename T> void build( const MinMaxPST_Node* first, const MinMaxPST_Node* last );
 
 	public:
-		MinMaxPST( const std::vector< MinMaxPST_Node >& points );
+		MinMaxPST(); // empty PST
+		MinMaxPST( const std::vector< MinMaxPST_Node >& points, size_t width = sizeof(coord_t), PSTLayout layout = PST_LAYOUT_HEAP );
+		MinMaxPST( const MinMaxPST_Node* first, const MinMaxPST_Node* last, size_t width = sizeof(coord_t), PSTLayout layout = PST_LAYOUT_HEAP ); // points in [first,last)
+		MinMaxPST( const void* array, size_t size, size_t width, std::shared_ptr<const void> storage, PSTLayout layout = PST_LAYOUT_HEAP ); // view of an array of size points in PST order, storage keeps it alive
 		~MinMaxPST();
+		static size_t narrowestWidth( coord_t maxCoord ); // smallest width that can store coordinates up to maxCoord
+		static size_t arraySize( size_t size, PSTLayout layout ); // nr of nodes in the array of size points
+		static size_t sizeOfArray( size_t nodes, PSTLayout layout ); // nr of points in an array of nodes nodes
 		void printArray() const;
-		std::vector< MinMaxPST_Node > getArray() const;
+		std::vector< MinMaxPST_Node > getArray() const; // nodes in heap order, or the points sorted by x for a range tree
+		const void* data() const; // arraySize(size(), getLayout()) nodes in PST order and getLayout() with getWidth() bytes per coordinate
+		size_t size() const;
+		size_t getWidth() const;
+		PSTLayout getLayout() const;
 		std::vector< MinMaxPST_Node > enumerateUp(coord_t x0, coord_t x1, coord_t y) const;
 		std::vector< MinMaxPST_Node > enumerateDown(coord_t x0, coord_t x1, coord_t y) const;
+		std::vector< std::vector< MinMaxPST_Node > > enumerateUp(const std::vector< MinMaxPST_Node >& queries) const;
 		MinMaxPST_Node leftmostNE(const MinMaxPST_Node& p) const;
 		MinMaxPST_Node rightmostNW(const MinMaxPST_Node& p) const;
 		MinMaxPST_Node highestNE(const MinMaxPST_Node& p) const;
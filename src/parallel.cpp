@@ -0,0 +1,34 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "parallel.h"
+
+size_t defaultThreads() {
+	const size_t n = std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+void parallelFor(size_t n, const std::function<void(size_t)>& f, size_t nrThreads) {
+	if (nrThreads <= 1 || n <= 1) {
+		for (size_t i = 0; i < n; i++)
+			f(i);
+		return;
+	}
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < n; i = next++)
+			f(i);
+	};
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < std::min(nrThreads, n); t++)
+		threads.push_back( std::thread(worker) );
+	worker();
+	for (auto& t : threads)
+		t.join();
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+
+// number of hardware threads (at least 1)
+size_t defaultThreads();
+
+// call f(i) for each i < n on up to nrThreads threads; indices are handed out one at a time
+void parallelFor(size_t n, const std::function<void(size_t)>& f, size_t nrThreads);
+
+// sort a with cmp: sort nrThreads chunks in parallel, then merge them pairwise
+template<typename T, typename Compare>
+void parallelSort(std::vector<T>& a, Compare cmp, size_t nrThreads) {
+	const size_t nrChunks = std::max<size_t>(1, std::min(nrThreads, a.size()));
+	std::vector<size_t> bounds;
+	for (size_t k = 0; k <= nrChunks; k++)
+		bounds.push_back(a.size() * k / nrChunks);
+	parallelFor(nrChunks, [&](size_t k) {
+			std::sort(a.begin() + bounds[k], a.begin() + bounds[k+1], cmp);
+		}, nrThreads);
+	for (size_t step = 1; step < nrChunks; step *= 2) {
+		parallelFor((nrChunks + 2*step - 1) / (2*step), [&](size_t k) {
+				const size_t first = 2*step*k;
+				const size_t mid = std::min(first + step, nrChunks);
+				const size_t last = std::min(first + 2*step, nrChunks);
+				std::inplace_merge(a.begin() + bounds[first], a.begin() + bounds[mid], a.begin() + bounds[last], cmp);
+			}, nrThreads);
+	}
+}
+
+#endif
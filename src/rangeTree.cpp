@@ -0,0 +1,286 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "rangeTree.h"
+
+//#define DEBUG
+#ifdef DEBUG
+#	define LOG(x) std::clog << "DEBUG: " << x << std::endl;
+#else
+#	define LOG(x) do {} while (0)
+#endif
+
+
+template<typename T>
+BasicRangeTree<T>::BasicRangeTree( const Node* array, size_t size, coord_t pINF, coord_t nINF ) : points(array), n(size), tree(array + size), posINF(pINF), negINF(nINF) {
+	nrBlocks = (n + RANGE_TREE_BLOCK - 1) / RANGE_TREE_BLOCK;
+	m = (n > 0) ? nrLeaves(n) : 0;
+}
+
+template<typename T>
+size_t BasicRangeTree<T>::nrLeaves( size_t size ) {
+	size_t res = 1;
+	while (res * RANGE_TREE_BLOCK < size)
+		res *= 2;
+	return res;
+}
+
+template<typename T>
+size_t BasicRangeTree<T>::arraySize( size_t size ) {
+	return (size > 0) ? size + 2 * nrLeaves(size) : 0;
+}
+
+// arraySize increases with the nr of points, so only one nr of leaves gives back the nr of nodes
+template<typename T>
+size_t BasicRangeTree<T>::sizeOfArray( size_t nodes ) {
+	for (size_t leaves = 1; 2 * leaves < nodes; leaves *= 2)
+		if (nrLeaves(nodes - 2 * leaves) == leaves)
+			return nodes - 2 * leaves;
+	return 0;
+}
+
+template<typename T>
+void BasicRangeTree<T>::build( std::vector<Node>& a ) {
+	std::sort(a.begin(), a.end());
+	const size_t size = a.size();
+	if (size == 0)
+		return;
+	const size_t leaves = nrLeaves(size);
+	// the leaves behind the last block have no points
+	a.resize( size + 2 * leaves, Node(std::numeric_limits<T>::max(), std::numeric_limits<T>::min()) );
+	Node* t = a.data() + size;
+	for (size_t i = 0; i < size; i++) {
+		Node& v = t[leaves + i / RANGE_TREE_BLOCK];
+		v.first = std::min(v.first, a[i].second);
+		v.second = std::max(v.second, a[i].second);
+	}
+	for (size_t v = leaves-1; v >= 1; v--) {
+		t[v].first = std::min(t[2*v].first, t[2*v+1].first);
+		t[v].second = std::max(t[2*v].second, t[2*v+1].second);
+	}
+}
+
+template<typename T>
+size_t BasicRangeTree<T>::first(coord_t x) const {
+	if (x > std::numeric_limits<T>::max())
+		return n;
+	return std::lower_bound(points, points + n, x, [](const Node& p, coord_t x) { return p.first < x; }) - points;
+}
+
+template<typename T>
+size_t BasicRangeTree<T>::end(coord_t x) const {
+	if (x >= std::numeric_limits<T>::max())
+		return n;
+	return std::upper_bound(points, points + n, x, [](coord_t x, const Node& p) { return x < p.first; }) - points;
+}
+
+template<typename T>
+template<bool Max>
+bool BasicRangeTree<T>::inY(coord_t v, coord_t y) const {
+	return Max ? v >= y : v <= y;
+}
+
+template<typename T>
+template<bool Max>
+bool BasicRangeTree<T>::subtreeInY(size_t v, coord_t y) const {
+	return inY<Max>(Max ? tree[v].second : tree[v].first, y);
+}
+
+// climb from leaf b until a subtree to the right of the path has a point in the y range, then descend to its first such leaf
+template<typename T>
+template<bool Max>
+size_t BasicRangeTree<T>::nextBlock(size_t b, coord_t y) const {
+	if (b >= nrBlocks)
+		return nrBlocks;
+	size_t v = m + b;
+	while (!subtreeInY<Max>(v, y)) {
+		while (v % 2 == 1)
+			v /= 2;
+		if (v == 0)
+			return nrBlocks;
+		v++;
+	}
+	while (v < m)
+		v = subtreeInY<Max>(2*v, y) ? 2*v : 2*v+1;
+	return std::min(v - m, nrBlocks);
+}
+
+// the same to the left; the subtrees left of the path hold no leaves behind the last block
+template<typename T>
+template<bool Max>
+size_t BasicRangeTree<T>::previousBlock(size_t b, coord_t y) const {
+	size_t v = m + b;
+	while (!subtreeInY<Max>(v, y)) {
+		while (v > 1 && v % 2 == 0)
+			v /= 2;
+		if (v == 1)
+			return nrBlocks;
+		v--;
+	}
+	while (v < m)
+		v = subtreeInY<Max>(2*v+1, y) ? 2*v+1 : 2*v;
+	return v - m;
+}
+
+template<typename T>
+template<bool Max>
+size_t BasicRangeTree<T>::next(size_t i, size_t j, coord_t y) const {
+	const size_t blockEnd = std::min( (i / RANGE_TREE_BLOCK + 1) * RANGE_TREE_BLOCK, j );
+	for (; i < blockEnd; i++)
+		if (inY<Max>(points[i].second, y))
+			return i;
+	if (i >= j)
+		return j;
+	const size_t b = nextBlock<Max>(i / RANGE_TREE_BLOCK, y);
+	if (b == nrBlocks || b * RANGE_TREE_BLOCK >= j)
+		return j;
+	for (i = b * RANGE_TREE_BLOCK; !inY<Max>(points[i].second, y); i++) {}
+	return (i < j) ? i : j;
+}
+
+template<typename T>
+template<bool Max>
+size_t BasicRangeTree<T>::previous(size_t i, size_t j, coord_t y) const {
+	if (i >= j)
+		return j;
+	size_t k = j;
+	const size_t blockBegin = std::max( (j-1) / RANGE_TREE_BLOCK * RANGE_TREE_BLOCK, i );
+	while (k > blockBegin)
+		if (inY<Max>(points[--k].second, y))
+			return k;
+	if (k == i)
+		return j;
+	// the blocks before k are complete
+	const size_t b = previousBlock<Max>(k / RANGE_TREE_BLOCK - 1, y);
+	if (b == nrBlocks || (b+1) * RANGE_TREE_BLOCK <= i)
+		return j;
+	for (k = (b+1) * RANGE_TREE_BLOCK - 1; !inY<Max>(points[k].second, y); k--) {}
+	return (k >= i) ? k : j;
+}
+
+// the partial blocks at the ends are scanned, the complete blocks between them through the tree
+template<typename T>
+template<bool Max>
+size_t BasicRangeTree<T>::extreme(size_t i, size_t j) const {
+	if (i >= j)
+		return j;
+	size_t res = i;
+	auto scan = [&](size_t from, size_t to) {
+		for (size_t k = from; k < to; k++)
+			if (Max ? points[k].second > points[res].second : points[k].second < points[res].second)
+				res = k;
+	};
+	const size_t bl = (i + RANGE_TREE_BLOCK - 1) / RANGE_TREE_BLOCK;	// first complete block
+	const size_t br = j / RANGE_TREE_BLOCK;								// behind the last complete block
+	if (bl >= br) {
+		scan(i, j);
+		return res;
+	}
+	scan(i, bl * RANGE_TREE_BLOCK);
+	scan(br * RANGE_TREE_BLOCK, j);
+	auto value = [&](size_t v) { return Max ? tree[v].second : tree[v].first; };
+	size_t v = 0;
+	for (size_t lo = m + bl, hi = m + br; lo < hi; lo /= 2, hi /= 2) {
+		if (lo % 2 == 1 && (v == 0 || (Max ? value(lo) > value(v) : value(lo) < value(v))))
+			v = lo;
+		if (lo % 2 == 1)
+			lo++;
+		if (hi % 2 == 1 && (v == 0 || (Max ? value(hi-1) > value(v) : value(hi-1) < value(v))))
+			v = hi-1;
+	}
+	while (v < m)
+		v = (value(2*v) == value(v)) ? 2*v : 2*v+1;
+	scan((v - m) * RANGE_TREE_BLOCK, (v - m + 1) * RANGE_TREE_BLOCK);
+	return res;
+}
+
+template<typename T>
+template<bool Max>
+std::vector< MinMaxPST_Node > BasicRangeTree<T>::enumerate(coord_t x0, coord_t x1, coord_t y) const {
+	std::vector< MinMaxPST_Node > res;
+	if (x0 > x1)
+		return res;
+	const size_t j = end(x1);
+	for (size_t i = next<Max>(first(x0), j, y); i < j; i = next<Max>(i+1, j, y))
+		res.push_back( MinMaxPST_Node(points[i]) );
+	return res;
+}
+
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::leftmostNE(const MinMaxPST_Node& o) const {
+	const size_t i = next<true>(first(o.first), n, o.second);
+	return (i < n) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::leftmostSE(const MinMaxPST_Node& o) const {
+	const size_t i = next<false>(first(o.first), n, o.second);
+	return (i < n) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::rightmostNW(const MinMaxPST_Node& o) const {
+	const size_t j = end(o.first);
+	const size_t i = previous<true>(0, j, o.second);
+	return (i < j) ? MinMaxPST_Node(points[i]) : std::make_pair(negINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::rightmostSW(const MinMaxPST_Node& o) const {
+	const size_t j = end(o.first);
+	const size_t i = previous<false>(0, j, o.second);
+	return (i < j) ? MinMaxPST_Node(points[i]) : std::make_pair(negINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::highestNE(const MinMaxPST_Node& o) const {
+	const size_t i = extreme<true>(first(o.first), n);
+	return (i < n && points[i].second >= o.second) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::highestNW(const MinMaxPST_Node& o) const {
+	const size_t j = end(o.first);
+	const size_t i = extreme<true>(0, j);
+	return (i < j && points[i].second >= o.second) ? MinMaxPST_Node(points[i]) : std::make_pair(negINF,posINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::lowestSE(const MinMaxPST_Node& o) const {
+	const size_t i = extreme<false>(first(o.first), n);
+	return (i < n && points[i].second <= o.second) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::lowestSW(const MinMaxPST_Node& o) const {
+	const size_t j = end(o.first);
+	const size_t i = extreme<false>(0, j);
+	return (i < j && points[i].second <= o.second) ? MinMaxPST_Node(points[i]) : std::make_pair(negINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::lowest3SideUp(coord_t x0, coord_t x1, coord_t y) const {
+	const size_t j = (x0 <= x1) ? end(x1) : 0;
+	const size_t i = extreme<false>(std::min(first(x0), j), j);
+	return (i < j && points[i].second <= y) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,negINF);
+}
+template<typename T>
+MinMaxPST_Node BasicRangeTree<T>::highest3SideDown(coord_t x0, coord_t x1, coord_t y) const {
+	const size_t j = (x0 <= x1) ? end(x1) : 0;
+	const size_t i = extreme<true>(std::min(first(x0), j), j);
+	return (i < j && points[i].second >= y) ? MinMaxPST_Node(points[i]) : std::make_pair(posINF,posINF);
+}
+
+template<typename T>
+std::vector< MinMaxPST_Node > BasicRangeTree<T>::enumerateUp(coord_t x0, coord_t x1, coord_t y) const { return enumerate<false>(x0, x1, y); }
+template<typename T>
+std::vector< MinMaxPST_Node > BasicRangeTree<T>::enumerateDown(coord_t x0, coord_t x1, coord_t y) const { return enumerate<true>(x0, x1, y); }
+
+// the points of each query are a scan from its x, so the queries share nothing
+template<typename T>
+std::vector< std::vector< MinMaxPST_Node > > BasicRangeTree<T>::enumerateUp(const std::vector< MinMaxPST_Node >& queries) const {
+	std::vector< std::vector< MinMaxPST_Node > > res(queries.size());
+	for (size_t q = 0; q < queries.size(); q++)
+		res[q] = enumerate<false>(queries[q].first, std::numeric_limits<coord_t>::max(), queries[q].second);
+	return res;
+}
+
+template class BasicRangeTree<uint32_t>;
+template class BasicRangeTree<uint64_t>;
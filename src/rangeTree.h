@@ -0,0 +1,67 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef RANGETREE_H
+#define RANGETREE_H
+
+#include <vector>
+#include <cstdint>
+
+#include "minmaxpst.h"
+
+// points per block of the x-sorted point array
+const size_t RANGE_TREE_BLOCK = 8;
+
+// alternative to the min-max PST for the same queries (PST_LAYOUT_RANGE_TREE): the points sorted by x in blocks of
+// RANGE_TREE_BLOCK points, followed by a complete binary tree over the blocks (a segment tree) that stores the
+// smallest and largest y coordinate below each node. A query finds its x range by binary search, scans blocks
+// and skips blocks without a point in the y range through the tree; the points are stored in external memory
+template<typename T>
+class BasicRangeTree {
+	public:
+		typedef std::pair<T,T> Node;
+
+	private:
+		const Node* points;		// sorted by x
+		size_t n;
+		const Node* tree;		// <smallest y, largest y> below node v (1-based) at tree[v]; the leaves m..2m-1 are the blocks
+		size_t nrBlocks;
+		size_t m;				// nr of leaves, a power of 2
+		coord_t posINF;
+		coord_t negINF;
+
+		static size_t nrLeaves(size_t size);
+		size_t first(coord_t x) const; // first point with x' >= x
+		size_t end(coord_t x) const; // first point with x' > x
+		template<bool Max> bool inY(coord_t v, coord_t y) const; // y' >= y (Max) or y' <= y
+		template<bool Max> bool subtreeInY(size_t v, coord_t y) const; // some point below tree node v in the y range
+		template<bool Max> size_t nextBlock(size_t b, coord_t y) const; // first block >= b with a point in the y range, nrBlocks if none
+		template<bool Max> size_t previousBlock(size_t b, coord_t y) const; // last block <= b with a point in the y range, nrBlocks if none
+		template<bool Max> size_t next(size_t i, size_t j, coord_t y) const; // first point in [i,j) in the y range, j if none
+		template<bool Max> size_t previous(size_t i, size_t j, coord_t y) const; // last point in [i,j) in the y range, j if none
+		template<bool Max> size_t extreme(size_t i, size_t j) const; // point with the largest (Max) or smallest y in [i,j), j if empty
+		template<bool Max> std::vector< MinMaxPST_Node > enumerate(coord_t x0, coord_t x1, coord_t y) const;
+
+	public:
+		BasicRangeTree( const Node* array, size_t size, coord_t posINF, coord_t negINF ); // view of an array of size points arranged by build
+		static void build( std::vector<Node>& a );	// sort the points by x and append the tree, O(n log n)
+		static size_t arraySize( size_t size );		// nr of nodes in the array of size points and their tree
+		static size_t sizeOfArray( size_t nodes );	// nr of points of an array of nodes nodes (inverse of arraySize)
+		// the queries of BasicMinMaxPST, with the same results (see minmaxpst.h)
+		MinMaxPST_Node leftmostNE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node rightmostNW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node highestNE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node highestNW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node leftmostSE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node rightmostSW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowestSE(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowestSW(const MinMaxPST_Node& p) const;
+		MinMaxPST_Node lowest3SideUp(coord_t x0, coord_t x1, coord_t y) const;
+		MinMaxPST_Node highest3SideDown(coord_t x0, coord_t x1, coord_t y) const;
+		std::vector< MinMaxPST_Node > enumerateUp(coord_t x0, coord_t x1, coord_t y) const;
+		std::vector< MinMaxPST_Node > enumerateDown(coord_t x0, coord_t x1, coord_t y) const;
+		std::vector< std::vector< MinMaxPST_Node > > enumerateUp(const std::vector< MinMaxPST_Node >& queries) const;
+};
+
+#endif
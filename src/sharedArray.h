@@ -0,0 +1,41 @@
+/*
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+#ifndef SHAREDARRAY_H
+#define SHAREDARRAY_H
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+
+// read-only array that either owns its elements (moved in from a vector) or
+// refers to external memory, e.g. a section of a memory-mapped index file;
+// storage keeps the backing memory alive, copies share it
+template<typename T>
+class SharedArray {
+	private:
+		const T* elements;
+		size_t n;
+		std::shared_ptr<const void> storage;
+
+	public:
+		SharedArray() : elements(nullptr), n(0) {}
+		SharedArray(std::vector<T>&& v) {
+			std::shared_ptr< std::vector<T> > owned = std::make_shared< std::vector<T> >( std::move(v) );
+			elements = owned->data();
+			n = owned->size();
+			storage = owned;
+		}
+		SharedArray(const T* e, size_t size, std::shared_ptr<const void> s) : elements(e), n(size), storage(s) {}
+
+		const T& operator[](size_t i) const { return elements[i]; }
+		const T* data() const { return elements; }
+		const T* begin() const { return elements; }
+		const T* end() const { return elements + n; }
+		size_t size() const { return n; }
+		bool empty() const { return n == 0; }
+};
+
+#endif
@@ -12,10 +12,12 @@
 #include <queue>
 #include <map>
 #include <set>
+#include <limits>
 
 #include "config.h"
 #include "trie.h"
 #include "helpers.h"
+#include "parallel.h"
 
 //#define DEBUG
 #ifdef DEBUG
@@ -24,6 +26,10 @@
 #	define LOG(x) do {} while (0)
 #endif
 
+// nodes per block of the node arena
+const size_t BLOCK_BITS = 16;
+const size_t BLOCK_SIZE = size_t(1) << BLOCK_BITS;
+
 
 /*
  * TrieNode class implementation
@@ -31,6 +37,8 @@
 
 TrieNode::TrieNode(char c) : content(c) {
 	end = false;
+	firstChild = 0;
+	nextSibling = 0;
 	preorder = -1;
 	postorder = -1;
 	mass = -1;
@@ -42,47 +50,24 @@ void TrieNode::setPreorder(size_t p) { preorder = p; }
 void TrieNode::setPostorder(size_t p) { postorder = p; }
 void TrieNode::setMass(size_t m) { mass = m; }
 void TrieNode::setParentPreorder(size_t p) { parent_preorder = p; }
+void TrieNode::setFirstChild(size_t i) { firstChild = i; }
+void TrieNode::setNextSibling(size_t i) { nextSibling = i; }
 bool TrieNode::isWordEnd() const { return end; }
 char TrieNode::getContent() const { return content; }
 size_t TrieNode::getPreorder() const { return preorder; }
 size_t TrieNode::getPostorder() const { return postorder; }
 size_t TrieNode::getParentPreorder() const { return parent_preorder; }
 size_t TrieNode::getMass() const { return mass; }
-std::vector<TrieNode*> TrieNode::getChildren() const { return children; }
-TrieNode* TrieNode::findChild(char c) const{
-	for ( auto child : children ) {
-		if (child->getContent() == c)
-			return child;
-	}
-	return nullptr;
-}
-
-bool cmp( TrieNode const * l , TrieNode const * r ) {
-	return l->getContent() < r->getContent();
-}
-
-bool TrieNode::addChild(TrieNode* p) {
-	if ( findChild(p->getContent()) == nullptr ) {
-		children.push_back(p);
-		std::sort(children.begin(), children.end(), cmp);
-		return true;
-	} else
-		return false;
-}
-
-// MODIFICATION-TOLERANT BPM
-#ifdef MOD_TOLERANT
-void TrieNode::setLastOcc( std::map<char,size_t> l ) { lastOcc = l; };
-const std::map<char,size_t>& TrieNode::getLastOcc() const { return lastOcc; }
-#endif
+size_t TrieNode::getFirstChild() const { return firstChild; }
+size_t TrieNode::getNextSibling() const { return nextSibling; }
 
 /*
  * Trie class implementation
  */
 
-Trie::Trie() {
-	root = new TrieNode( char(0) );
-	nrNodes = 1;
+Trie::Trie(size_t t) : nrThreads(t) {
+	nrNodes = 0;
+	newNode( char(0) );
 	finalized = false;
 	order = false;
 	mass = false;
@@ -91,74 +76,283 @@ Trie::Trie() {
 #endif
 }
 
-Trie::~Trie() {
-	finalized = false;
-	if (nrNodes > 0)
-		deleteNode(root);
-	assert(nrNodes == 0);
+// all nodes are released with their blocks
+Trie::~Trie() {}
+
+TrieNode& Trie::node(size_t i) { return blocks[i >> BLOCK_BITS][i & (BLOCK_SIZE-1)]; }
+const TrieNode& Trie::node(size_t i) const { return blocks[i >> BLOCK_BITS][i & (BLOCK_SIZE-1)]; }
+
+size_t Trie::newNode(char c) {
+	if (nrNodes % BLOCK_SIZE == 0) {
+		blocks.push_back( std::vector<TrieNode>() );
+		blocks.back().reserve(BLOCK_SIZE);
+	}
+	blocks.back().push_back( TrieNode(c) );
+	return nrNodes++;
+}
+
+void Trie::resize(size_t n) {
+	assert( n >= nrNodes );
+	while (nrNodes < n) {
+		if (nrNodes % BLOCK_SIZE == 0) {
+			blocks.push_back( std::vector<TrieNode>() );
+			blocks.back().reserve(BLOCK_SIZE);
+		}
+		const size_t k = std::min(n - nrNodes, BLOCK_SIZE - blocks.back().size());
+		blocks.back().resize( blocks.back().size() + k, TrieNode( char(0) ) );
+		nrNodes += k;
+	}
 }
 
-void Trie::add(std::string w, std::string protein) {
+size_t Trie::findChild(size_t p, char c) const {
+	for ( size_t i = node(p).getFirstChild(); i != 0; i = node(i).getNextSibling() ) {
+		if (node(i).getContent() == c)
+			return i;
+		if (c < node(i).getContent())
+			break;
+	}
+	return 0;
+}
+
+size_t Trie::addChild(size_t p, char c) {
+	// keep the children sorted by content
+	size_t prev = 0;
+	size_t i = node(p).getFirstChild();
+	while ( i != 0 && node(i).getContent() < c ) {
+		prev = i;
+		i = node(i).getNextSibling();
+	}
+	if ( i != 0 && node(i).getContent() == c )
+		return i;
+	const size_t child = newNode(c);
+	node(child).setNextSibling(i);
+	if (prev == 0)
+		node(p).setFirstChild(child);
+	else
+		node(prev).setNextSibling(child);
+	return child;
+}
+
+void Trie::add(const std::string& w, const std::string& protein, size_t textPos) {
 	assert( !finalized );
-	TrieNode* cur = root;
-	std::string::iterator it = w.begin();
-	while ( it != w.end() ) {
-		if ( cur->findChild(*it) == nullptr ) {
-			TrieNode* next = new TrieNode(*it);
-			cur->addChild(next);
-			nrNodes++;
-			cur = next;
-		} else {
-			cur = cur->findChild(*it);
+	size_t cur = 0;
+	for ( auto c : w )
+		cur = addChild(cur, c);
+	if (!node(cur).isWordEnd()) {
+		const std::array<size_t,2> pos = {{ textPos, w.size() }};
+		wordEnds.push_back( std::make_pair(cur, pos) );
+	}
+	node(cur).setWordEnd(0);
+}
+
+// counting sort of the positions in in by key[position] < nrKeys
+template<typename T>
+void countingSort( const std::vector<T>& in, std::vector<T>& out, const std::vector<T>& key, size_t nrKeys ) {
+	std::vector<T> count(nrKeys+1, 0);
+	for ( auto i : in )
+		count[key[i]+1]++;
+	for ( size_t k = 1; k < count.size(); k++ )
+		count[k] += count[k-1];
+	out.resize(in.size());
+	for ( auto i : in )
+		out[count[key[i]]++] = i;
+}
+
+// positions of the suffixes of the ranges <text position, length> of text, sorted by their first maxLength chars
+// (prefix doubling with radix sort; the order of suffixes with the same first maxLength chars is arbitrary)
+template<typename T>
+std::vector<T> sortSuffixes( const std::string& text, const std::vector< std::array<size_t,2> >& ranges, size_t maxLength ) {
+	std::vector<T> sa;
+	std::vector<T> tmp;
+	std::vector<T> rank(text.size(), 0);	// rank of the prefix of length h of each suffix, 0 for the empty suffix
+	std::vector<T> next(text.size(), 0);	// rank of the suffix h chars later
+	for ( auto r : ranges ) {
+		for ( size_t i = r[0]; i < r[0] + r[1]; i++ ) {
+			tmp.push_back(i);
+			rank[i] = static_cast<unsigned char>(text[i]) + 1;
 		}
-		it++;
 	}
-	cur->setWordEnd(proteinID.find(protein)->second);
+	size_t nrRanks = 257;
+	for ( size_t h = 1; ; h *= 2 ) {
+		for ( auto r : ranges )
+			for ( size_t i = r[0]; i < r[0] + r[1]; i++ )
+				next[i] = (i + h < r[0] + r[1]) ? rank[i+h] : 0;
+		countingSort(tmp, sa, next, nrRanks);
+		countingSort(sa, tmp, rank, nrRanks);
+		sa.swap(tmp);
+
+		// new ranks for the prefixes of length 2h
+		T r = 0;
+		T lastRank = 0;
+		T lastNext = 0;
+		for ( size_t k = 0; k < sa.size(); k++ ) {
+			if ( k == 0 || rank[sa[k]] != lastRank || next[sa[k]] != lastNext )
+				r++;
+			lastRank = rank[sa[k]];
+			lastNext = next[sa[k]];
+			rank[sa[k]] = r;
+		}
+		nrRanks = r + 1;
+		if ( r == sa.size() || 2*h >= maxLength )
+			break;
+	}
+	return sa;
+}
+
+void Trie::addSuffixes(const std::string& text, const std::vector< std::array<size_t,2> >& ranges, size_t maxLength) {
+	assert( !finalized && nrNodes == 1 );
+	if (text.size() < std::numeric_limits<uint32_t>::max())
+		addSortedSuffixes( sortSuffixes<uint32_t>(text, ranges, maxLength), text, ranges, maxLength );
+	else
+		addSortedSuffixes( sortSuffixes<size_t>(text, ranges, maxLength), text, ranges, maxLength );
+}
+
+// add the suffixes in lexicographic order, so the nodes are created in preorder and every new node is the
+// last child of its parent; the shards of suffixes with the same first char are added in parallel
+template<typename T>
+void Trie::addSortedSuffixes(const std::vector<T>& sa, const std::string& text, const std::vector< std::array<size_t,2> >& ranges, size_t maxLength) {
+	if (sa.empty())
+		return;
+
+	// end of the range of each position
+	std::vector<size_t> rangeStart(ranges.size());
+	std::vector<size_t> rangeEnd(ranges.size());
+	for ( size_t r = 0; r < ranges.size(); r++ ) {
+		rangeStart[r] = ranges[r][0];
+		rangeEnd[r] = ranges[r][0] + ranges[r][1];
+	}
+	auto length = [&](size_t i) {
+		const size_t r = std::upper_bound(rangeStart.begin(), rangeStart.end(), i) - rangeStart.begin() - 1;
+		return std::min(maxLength, rangeEnd[r] - i);
+	};
+
+	// shard s consists of the suffixes sa[shards[s]..shards[s+1])
+	std::vector<size_t> shards(1, 0);
+	for ( size_t k = 1; k < sa.size(); k++ ) {
+		if (text[sa[k]] != text[sa[k-1]])
+			shards.push_back(k);
+	}
+	shards.push_back(sa.size());
+	const size_t nrShards = shards.size() - 1;
+
+	// nodes of each shard (chars of each suffix not shared with the last one), shard s gets the indices first[s]..first[s+1]
+	std::vector<size_t> first(nrShards+1, 0);
+	parallelFor(nrShards, [&](size_t s) {
+			size_t last = 0;
+			size_t lastLength = 0;
+			for ( size_t k = shards[s]; k < shards[s+1]; k++ ) {
+				const size_t i = sa[k];
+				const size_t len = length(i);
+				size_t l = 0;
+				while ( l < len && l < lastLength && text[i+l] == text[last+l] )
+					l++;
+				first[s+1] += len - l;
+				last = i;
+				lastLength = len;
+			}
+		}, nrThreads);
+	first[0] = 1;
+	for ( size_t s = 0; s < nrShards; s++ )
+		first[s+1] += first[s];
+	resize(first[nrShards]);
+
+	std::vector< std::vector< std::pair< size_t, std::array<size_t,2> > > > shardWordEnds(nrShards);
+	parallelFor(nrShards, [&](size_t s) {
+			size_t next = first[s];
+			std::vector<size_t> path(1, 0);	// path[d] is the node at depth d of the last suffix
+			for ( size_t k = shards[s]; k < shards[s+1]; k++ ) {
+				const size_t i = sa[k];
+				const size_t len = length(i);
+				// longest common prefix with the last suffix
+				size_t l = 0;
+				while ( l < len && l+1 < path.size() && node(path[l+1]).getContent() == text[i+l] )
+					l++;
+				// the last node at depth l+1 is the previous sibling of the new one
+				size_t prev = (l+1 < path.size()) ? path[l+1] : 0;
+				path.resize(l+1);
+				for ( size_t d = l; d < len; d++ ) {
+					node(next) = TrieNode(text[i+d]);
+					if (prev != 0)
+						node(prev).setNextSibling(next);
+					else if (d > 0)
+						node(path.back()).setFirstChild(next);
+					prev = 0;
+					path.push_back(next++);
+				}
+				// equal words are adjacent, keep the first occurrence in text
+				const size_t cur = path.back();
+				if (!node(cur).isWordEnd()) {
+					const std::array<size_t,2> pos = {{ i, len }};
+					shardWordEnds[s].push_back( std::make_pair(cur, pos) );
+					node(cur).setWordEnd(0);
+				} else if (shardWordEnds[s].back().first == cur && i < shardWordEnds[s].back().second[0])
+					shardWordEnds[s].back().second[0] = i;
+			}
+			assert( next == first[s+1] );
+		}, nrThreads);
+
+	// the first node of each shard is a child of the root
+	node(0).setFirstChild(first[0]);
+	for ( size_t s = 1; s < nrShards; s++ )
+		node(first[s-1]).setNextSibling(first[s]);
+	for ( auto& w : shardWordEnds ) {
+		wordEnds.insert(wordEnds.end(), w.begin(), w.end());
+		std::vector< std::pair< size_t, std::array<size_t,2> > >().swap(w);
+	}
 }
 
 bool Trie::find(std::string w) const {
-	TrieNode* cur = root;
+	size_t cur = 0;
 	std::string::iterator it = w.begin();
 	while ( it != w.end() ) {
-		if ( cur->findChild(*it) == nullptr )
+		cur = findChild(cur, *it);
+		if ( cur == 0 )
 			return false;
-		else
-			cur = cur->findChild(*it);
-		LOG( "(" + std::to_string(cur->getPreorder()) + "," + std::to_string(cur->getPostorder()) + ") -- " + std::to_string(cur->getMass()) );
+		LOG( "(" + std::to_string(node(cur).getPreorder()) + "," + std::to_string(node(cur).getPostorder()) + ") -- " + std::to_string(node(cur).getMass()) );
 		it++;
 	}
-	return cur->isWordEnd();
+	return node(cur).isWordEnd();
 }
 
 size_t Trie::size() const { return nrNodes; }
 
-std::map< size_t, std::vector< std::pair<size_t,size_t> > >& Trie::getNodesByMass( std::map< size_t, std::vector< std::pair<size_t,size_t> > >& res) {
-	// [mass, preorder, postorder] for each node
+void Trie::getNodesByMass( std::vector<size_t>& masses, std::vector<size_t>& offsets, std::vector< std::pair<size_t,size_t> >& points ) {
 	finalize();
 
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	TrieNode* cur = nullptr;
-	while (!stack.empty()) {
-		cur = stack.top();
-		stack.pop();
-		if (res.find( cur->getMass() ) == res.end())
-			res.insert( std::make_pair( 
-						cur->getMass(), 
-						std::vector< std::pair<size_t,size_t> >() ) );
-		res.find(cur->getMass())->second.push_back( std::make_pair( cur->getPreorder(), cur->getPostorder()) );
-		for ( auto c : cur->getChildren() )
-			stack.push(c);
+	// [mass, preorder, postorder] for each node
+	std::vector< std::array<size_t,3> > nodes(nrNodes);
+	parallelFor(blocks.size(), [&](size_t b) {
+			for ( size_t i = b*BLOCK_SIZE; i < std::min(nrNodes, (b+1)*BLOCK_SIZE); i++ ) {
+				const std::array<size_t,3> n = {{ node(i).getMass(), node(i).getPreorder(), node(i).getPostorder() }};
+				nodes[i] = n;
+			}
+		}, nrThreads);
+	parallelSort(nodes, [](const std::array<size_t,3>& a, const std::array<size_t,3>& b) { return a < b; }, nrThreads);
+
+	masses.clear();
+	offsets.clear();
+	points.clear();
+	points.reserve(nrNodes);
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		if (i == 0 || nodes[i][0] != nodes[i-1][0]) {
+			masses.push_back(nodes[i][0]);
+			offsets.push_back(i);
+		}
+		points.push_back( std::make_pair(nodes[i][1], nodes[i][2]) );
 	}
-	return res;
+	offsets.push_back(nodes.size());
 }
 
-void Trie::deleteNode(TrieNode * cur) {
-	assert( !finalized );
-	for (auto c : cur->getChildren() )
-		deleteNode(c);
-	delete cur;
-	nrNodes--;
+std::map< size_t, std::vector< std::pair<size_t,size_t> > >& Trie::getNodesByMass( std::map< size_t, std::vector< std::pair<size_t,size_t> > >& res) {
+	std::vector<size_t> masses;
+	std::vector<size_t> offsets;
+	std::vector< std::pair<size_t,size_t> > points;
+	getNodesByMass(masses, offsets, points);
+	for ( size_t i = 0; i < masses.size(); i++ ) {
+		std::vector< std::pair<size_t,size_t> >& v = res[masses[i]];
+		v.insert( v.end(), points.begin() + offsets[i], points.begin() + offsets[i+1] );
+	}
+	return res;
 }
 
 void Trie::finalize() {
@@ -170,46 +364,84 @@ void Trie::finalize() {
 #endif
 }
 
-void Trie::computeOrder() {
-	assert( finalized );
-	if (order) return;
+std::vector<size_t> Trie::getSubtrees() const {
+	std::vector<size_t> res;
+	for ( size_t c = node(0).getFirstChild(); c != 0; c = node(c).getNextSibling() )
+		res.push_back(c);
+	return res;
+}
 
-	// preorder
+size_t Trie::numberSubtree(size_t r) {
+	// preorder (the next sibling of a node is visited after its subtree)
 	size_t i = 0;
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	TrieNode* cur = nullptr;
-	root->setParentPreorder(0);
+	std::stack<size_t> stack;
+	stack.push(r);
 	while(!stack.empty()) {
-		TrieNode* cur = stack.top();
+		const size_t cur = stack.top();
 		stack.pop();
-		cur->setPreorder(i);
-		const std::vector<TrieNode*> children = cur->getChildren();
-		for ( auto it = children.rbegin(); it != children.rend(); it++ ) {
-			stack.push(*it);
-			(*it)->setParentPreorder(i);
-		}
+		node(cur).setPreorder(i);
+		for ( size_t c = node(cur).getFirstChild(); c != 0; c = node(c).getNextSibling() )
+			node(c).setParentPreorder(i);
+		if (cur != r && node(cur).getNextSibling() != 0)
+			stack.push(node(cur).getNextSibling());
+		if (node(cur).getFirstChild() != 0)
+			stack.push(node(cur).getFirstChild());
 		i++;
 	}
 
 	// postorder (using two stacks)
 	i = 0;
-	std::stack<TrieNode*> s1;
-	std::stack<TrieNode*> s2;
-	s1.push(root);
-	cur = nullptr;
+	std::stack<size_t> s1;
+	std::stack<size_t> s2;
+	s1.push(r);
 	while(!s1.empty()) {
-		s2.push( s1.top() );
-		cur = s1.top();
+		const size_t cur = s1.top();
+		s2.push(cur);
 		s1.pop();
-		for ( auto c : cur->getChildren() )
+		for ( size_t c = node(cur).getFirstChild(); c != 0; c = node(c).getNextSibling() )
 			s1.push(c);
 	}
 	while(!s2.empty()) {
-		s2.top()->setPostorder(i);
+		node(s2.top()).setPostorder(i);
 		i++;
 		s2.pop();
 	}
+	return i;
+}
+
+void Trie::shiftSubtree(size_t r, size_t preOffset, size_t postOffset) {
+	std::stack<size_t> stack;
+	stack.push(r);
+	while(!stack.empty()) {
+		TrieNode& cur = node(stack.top());
+		stack.pop();
+		cur.setPreorder(cur.getPreorder() + preOffset);
+		cur.setPostorder(cur.getPostorder() + postOffset);
+		cur.setParentPreorder(cur.getParentPreorder() + preOffset);
+		for ( size_t c = cur.getFirstChild(); c != 0; c = node(c).getNextSibling() )
+			stack.push(c);
+	}
+	node(r).setParentPreorder(0);
+}
+
+void Trie::computeOrder() {
+	assert( finalized );
+	if (order) return;
+
+	// number the subtrees of the children of the root in parallel, then shift them behind each other
+	const std::vector<size_t> subtrees = getSubtrees();
+	std::vector<size_t> offsets(subtrees.size()+1, 0);
+	parallelFor(subtrees.size(), [&](size_t k) {
+			offsets[k+1] = numberSubtree(subtrees[k]);
+		}, nrThreads);
+	for ( size_t k = 0; k < subtrees.size(); k++ )
+		offsets[k+1] += offsets[k];
+	parallelFor(subtrees.size(), [&](size_t k) {
+			shiftSubtree(subtrees[k], offsets[k]+1, offsets[k]);
+		}, nrThreads);
+	node(0).setPreorder(0);
+	node(0).setPostorder(nrNodes-1);
+	node(0).setParentPreorder(0);
 
 	order = true;
 }
@@ -218,20 +450,23 @@ void Trie::computeMass() {
 	assert( finalized );
 	if (mass) return;
 
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	root->setMass(0);
-	TrieNode* cur = nullptr;
-	while(!stack.empty()) {
-		cur = stack.top();
-		stack.pop();
-		assert( cur->getMass() >= 0 );
-		for ( auto c : cur->getChildren() ) {
-			assert(cfg::AAmasses.find(c->getContent()) != cfg::AAmasses.end());
-			c->setMass( cur->getMass() + cfg::AAmasses.at( c->getContent() ) );
-			stack.push(c);
-		}
-	}
+	node(0).setMass(0);
+	const std::vector<size_t> subtrees = getSubtrees();
+	parallelFor(subtrees.size(), [&](size_t k) {
+			assert(cfg::AAmasses.find(node(subtrees[k]).getContent()) != cfg::AAmasses.end());
+			node(subtrees[k]).setMass( cfg::AAmasses.at( node(subtrees[k]).getContent() ) );
+			std::stack<size_t> stack;
+			stack.push(subtrees[k]);
+			while(!stack.empty()) {
+				const size_t cur = stack.top();
+				stack.pop();
+				for ( size_t c = node(cur).getFirstChild(); c != 0; c = node(c).getNextSibling() ) {
+					assert(cfg::AAmasses.find(node(c).getContent()) != cfg::AAmasses.end());
+					node(c).setMass( node(cur).getMass() + cfg::AAmasses.at( node(c).getContent() ) );
+					stack.push(c);
+				}
+			}
+		}, nrThreads);
 
 	mass = true;
 }
@@ -241,39 +476,90 @@ std::vector< std::pair<size_t,size_t> > Trie::getLeaves() const {
 
 	std::vector< std::pair<size_t,size_t> > res;
 
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	TrieNode* cur = nullptr;
+	// preorder traversal
+	std::stack<size_t> stack;
+	stack.push(0);
 	while(!stack.empty()) {
-		cur = stack.top();
+		const TrieNode& cur = node(stack.top());
 		stack.pop();
-		if (cur->isWordEnd())
-			res.push_back( std::make_pair( cur->getPreorder(), cur->getPostorder() ) );
-		const std::vector<TrieNode*> children = cur->getChildren();
-		for ( auto it = children.rbegin(); it != children.rend(); it++ )
-			stack.push(*it);
+		if (cur.isWordEnd())
+			res.push_back( std::make_pair( cur.getPreorder(), cur.getPostorder() ) );
+		if (cur.getNextSibling() != 0)
+			stack.push(cur.getNextSibling());
+		if (cur.getFirstChild() != 0)
+			stack.push(cur.getFirstChild());
+	}
+
+	return res;
+}
+
+std::vector< std::pair<size_t,size_t> >& Trie::getOrder( std::vector< std::pair<size_t,size_t> >& res ) {
+	finalize();
+
+	res.resize(nrNodes);
+	for ( size_t i = 0; i < nrNodes; i++ )
+		res.at(node(i).getPreorder()) = std::make_pair( node(i).getPostorder(), node(i).getParentPreorder() );
+	return res;
+}
+
+TrieTable Trie::getTrieTable( size_t width ) {
+	finalize();
+
+	// consecutive <postorder, parent_preorder> values for each node indexed by preorder
+	if (width == sizeof(uint32_t)) {
+		assert( nrNodes <= std::numeric_limits<uint32_t>::max() );
+		std::vector<uint32_t> res(2*nrNodes);
+		for ( size_t i = 0; i < nrNodes; i++ ) {
+			res[2*node(i).getPreorder()] = node(i).getPostorder();
+			res[2*node(i).getPreorder()+1] = node(i).getParentPreorder();
+		}
+		return TrieTable( SharedArray<uint32_t>( std::move(res) ) );
+	}
+	std::vector<uint64_t> res(2*nrNodes);
+	for ( size_t i = 0; i < nrNodes; i++ ) {
+		res[2*node(i).getPreorder()] = node(i).getPostorder();
+		res[2*node(i).getPreorder()+1] = node(i).getParentPreorder();
 	}
+	return TrieTable( SharedArray<uint64_t>( std::move(res) ) );
+}
+
+std::map< size_t, std::string >& Trie::getLeafSeqs( std::map< size_t, std::string >& res ) const {
+	assert( finalized && order );
 
+	for ( auto l : getLeaves() )
+		res.insert( std::make_pair( l.first, getString(l.first) ) );
 	return res;
 }
 
+LeafTable Trie::getLeafTable( const std::string& text ) const {
+	assert( finalized && order );
+
+	std::vector<LeafEntry> dir;
+	dir.reserve(wordEnds.size());
+	for ( auto w : wordEnds ) {
+		LeafEntry e = { node(w.first).getPreorder(), w.second[0], w.second[1] };
+		assert( e.offset + e.length <= text.size() );
+		dir.push_back(e);
+	}
+	std::sort( dir.begin(), dir.end(), [](const LeafEntry& a, const LeafEntry& b) { return a.preorder < b.preorder; } );
+	return LeafTable( SharedArray<LeafEntry>( std::move(dir) ), SharedArray<char>( std::vector<char>(text.begin(), text.end()) ) );
+}
+
 std::string Trie::getString( size_t preorder ) const {
 	assert( finalized && order );
 	assert( preorder < nrNodes );
 
 	std::string s;
-	TrieNode* cur = root;
-	TrieNode* next = nullptr;
-	while ( cur->getPreorder() != preorder ) {
-		assert(  cur->getPreorder() < preorder );
-		for (auto c : cur->getChildren()) {
-			if (c->getPreorder() <= preorder)
-				next = c;
-		}
-		assert( next != nullptr );
-		s.push_back(next->getContent());
+	size_t cur = 0;
+	size_t next = 0;
+	while ( node(cur).getPreorder() != preorder ) {
+		assert(  node(cur).getPreorder() < preorder );
+		for ( size_t c = node(cur).getFirstChild(); c != 0 && node(c).getPreorder() <= preorder; c = node(c).getNextSibling() )
+			next = c;
+		assert( next != 0 );
+		s.push_back(node(next).getContent());
 		cur = next;
-		next = nullptr;
+		next = 0;
 	}
 	return s;
 }
@@ -284,35 +570,12 @@ std::ostream& Trie::outputNodes (std::ostream& o) {
 
 	LOG("Start outputNodes");
 	o << std::to_string(nrNodes) + '\n';
-	
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	TrieNode* cur = nullptr;
+
+	std::stack<size_t> stack;
+	stack.push(0);
 #ifdef MOD_TOLERANT
-	std::vector<char> AA;
-	std::vector<char>::iterator it;
-	for ( auto a : cfg::allSitesMods ) {
-		it = std::lower_bound(AA.begin(), AA.end(), a.first);
-		if (it == AA.end() || *it != a.first) {
-			AA.push_back(a.first);
-			std::sort(AA.begin(), AA.end());
-		}
-	}
-	for ( auto a : cfg::cTermMods ) {
-		it = std::lower_bound(AA.begin(), AA.end(), a.first);
-		if (it == AA.end() || *it != a.first) {
-			AA.push_back(a.first);
-			std::sort(AA.begin(), AA.end());
-		}
-	}
-	for ( auto a : cfg::nTermMods ) {
-		it = std::lower_bound(AA.begin(), AA.end(), a.first);
-		if (it == AA.end() || *it != a.first) {
-			AA.push_back(a.first);
-			std::sort(AA.begin(), AA.end());
-		}
-	}
 	computeLastOcc();
+	const std::vector<char>& AA = lastOccOrder;
 	res += "LASTOCC-ORDER:" + std::to_string(AA.size()) + ":";
 	for (auto a : AA)
 		res += std::string(1,a) + ",";
@@ -330,13 +593,14 @@ std::ostream& Trie::outputNodes (std::ostream& o) {
 #endif
 
 	// output root information
-	res += std::to_string(root->getPreorder()) + "," +
-		   std::to_string(root->getPostorder()) + "," +
-		   std::to_string(root->getParentPreorder()) + "," +
+	const TrieNode& root = node(0);
+	res += std::to_string(root.getPreorder()) + "," +
+		   std::to_string(root.getPostorder()) + "," +
+		   std::to_string(root.getParentPreorder()) + "," +
 		   ",";
 #ifdef MOD_TOLERANT
 	for (auto a : AA)
-		res += std::to_string(root->getLastOcc().find(a)->second) + ",";
+		res += std::to_string(getLastOcc(root.getPreorder(), a)) + ",";
 	res.pop_back();
 #endif
 	res += ",";
@@ -345,28 +609,29 @@ std::ostream& Trie::outputNodes (std::ostream& o) {
 	res.clear();
 
 	while(!stack.empty()) {
-		cur = stack.top();
+		const size_t cur = stack.top();
 		stack.pop();
-		for ( auto it : cur->getChildren() ) {
-			res += std::to_string(it->getPreorder()) + "," + 
-				std::to_string(it->getPostorder()) + "," +
-				std::to_string(it->getParentPreorder()) + ",";
-			if (it->isWordEnd())
-				res += getString(it->getPreorder()) + ",";
+		for ( size_t c = node(cur).getFirstChild(); c != 0; c = node(c).getNextSibling() ) {
+			const TrieNode& it = node(c);
+			res += std::to_string(it.getPreorder()) + "," +
+				std::to_string(it.getPostorder()) + "," +
+				std::to_string(it.getParentPreorder()) + ",";
+			if (it.isWordEnd())
+				res += getString(it.getPreorder()) + ",";
 			else
 				res += ",";
 			// LastOcc
 #ifdef MOD_TOLERANT
 			for (auto a : AA)
-				res += std::to_string(it->getLastOcc().find(a)->second) + ",";
+				res += std::to_string(getLastOcc(it.getPreorder(), a)) + ",";
 			res.pop_back();
 #endif
 			res += ",";
 			// Links
 #ifdef MUT_TOLERANT
-			if (links.find(it->getPreorder()) != links.end()) {
-				res += "|" + std::to_string(links.find(it->getPreorder())->second.size()) + ":";
-					for ( auto l : links.find(it->getPreorder())->second )
+			if (links.find(it.getPreorder()) != links.end()) {
+				res += "|" + std::to_string(links.find(it.getPreorder())->second.size()) + ":";
+					for ( auto l : links.find(it.getPreorder())->second )
 						res += std::to_string(l) + ",";
 					res.pop_back();
 			}
@@ -374,7 +639,7 @@ std::ostream& Trie::outputNodes (std::ostream& o) {
 			res += '\n';
 			o << res;
 			res.clear();
-			stack.push(it);
+			stack.push(c);
 		}
 	}
 	return o;
@@ -383,49 +648,45 @@ std::ostream& Trie::outputNodes (std::ostream& o) {
 std::ostream& operator<< (std::ostream& o, Trie& t) {
 	return t.outputNodes(o);
 }
-/* 
+/*
  * MODIFICATION-TOLERANT BPM
  */
 #ifdef MOD_TOLERANT
 void Trie::computeLastOcc() {
-	assert(finalized);
+	assert(finalized && order);
 	if (lastOcc) return;
 
-	std::map<char,size_t> lastOcc;
-	for ( auto a : cfg::allSitesMods ) {
-		if (lastOcc.find(a.first) == lastOcc.end())
-			lastOcc.insert(std::make_pair(a.first,0));
-	}
-	for ( auto a : cfg::cTermMods ) {
-		if (lastOcc.find(a.first) == lastOcc.end())
-			lastOcc.insert(std::make_pair(a.first,0));
-	}
-	for ( auto a : cfg::nTermMods ) {
-		if (lastOcc.find(a.first) == lastOcc.end())
-			lastOcc.insert(std::make_pair(a.first,0));
-	}
-
-	std::queue<TrieNode*> queue;
-	queue.push(root);
-	root->setLastOcc(lastOcc);
-	TrieNode* cur = nullptr;
-	while(!queue.empty()) {
-		cur = queue.front();
-		queue.pop();
-		lastOcc = cur->getLastOcc();
-		if (lastOcc.find(cur->getContent()) != lastOcc.end())
-			lastOcc.find(cur->getContent())->second = cur->getPreorder();
-		cur->setLastOcc(lastOcc);
-		const std::vector<TrieNode*> children = cur->getChildren();
-		for ( auto it = children.rbegin(); it != children.rend(); it++ ) {
-			(*it)->setLastOcc(lastOcc);
-			queue.push(*it);
-		}
+	std::set<char> chars;
+	for ( auto a : cfg::allSitesMods )
+		chars.insert(a.first);
+	for ( auto a : cfg::cTermMods )
+		chars.insert(a.first);
+	for ( auto a : cfg::nTermMods )
+		chars.insert(a.first);
+	lastOccOrder.assign(chars.begin(), chars.end());
+
+	// parents are created before their children, the root has no modified characters
+	const size_t k = lastOccOrder.size();
+	lastOccTable.assign(nrNodes * k, 0);
+	for ( size_t i = 1; i < nrNodes; i++ ) {
+		const TrieNode& cur = node(i);
+		std::copy( lastOccTable.begin() + cur.getParentPreorder() * k,
+				   lastOccTable.begin() + (cur.getParentPreorder()+1) * k,
+				   lastOccTable.begin() + cur.getPreorder() * k );
+		const std::vector<char>::const_iterator a = std::lower_bound(lastOccOrder.begin(), lastOccOrder.end(), cur.getContent());
+		if (a != lastOccOrder.end() && *a == cur.getContent())
+			lastOccTable[cur.getPreorder() * k + (a - lastOccOrder.begin())] = cur.getPreorder();
 	}
 
 	this->lastOcc = true;
 }
 
+size_t Trie::getLastOcc( size_t preorder, char a ) const {
+	const std::vector<char>::const_iterator it = std::lower_bound(lastOccOrder.begin(), lastOccOrder.end(), a);
+	assert( it != lastOccOrder.end() && *it == a );
+	return lastOccTable[preorder * lastOccOrder.size() + (it - lastOccOrder.begin())];
+}
+
 std::map<size_t,std::map<char,size_t>> Trie::outputLastOcc() {
 	if(!finalized)
 		finalize();
@@ -434,18 +695,26 @@ std::map<size_t,std::map<char,size_t>> Trie::outputLastOcc() {
 	computeOrder();
 	computeLastOcc();
 
-	std::stack<TrieNode*> stack;
-	stack.push(root);
-	TrieNode* cur = nullptr;
-	while (!stack.empty()) {
-		cur = stack.top();
-		stack.pop();
-		res.insert( std::make_pair(cur->getPreorder(), cur->getLastOcc()) );
-		for ( auto c : cur->getChildren() )
-			stack.push(c);
+	for ( size_t p = 0; p < nrNodes; p++ ) {
+		std::map<char,size_t> l;
+		for ( auto a : lastOccOrder )
+			l.insert( std::make_pair(a, getLastOcc(p, a)) );
+		res.insert( std::make_pair(p, l) );
 	}
 	return res;
 }
+
+std::vector<size_t>& Trie::getLastOccTable( std::vector<char>& order, std::vector<size_t>& res ) {
+	if(!finalized)
+		finalize();
+	assert(finalized);
+	computeOrder();
+	computeLastOcc();
+
+	order = lastOccOrder;
+	res = lastOccTable;
+	return res;
+}
 #endif
 
 
@@ -454,42 +723,39 @@ std::map<size_t,std::map<char,size_t>> Trie::outputLastOcc() {
  */
 #ifdef MUT_TOLERANT
 size_t Trie::findPreorder(std::string w) const {
-	TrieNode* cur = root;
+	size_t cur = 0;
 	std::string::iterator it = w.begin();
 	while ( it != w.end() ) {
-		if ( cur->findChild(*it) == nullptr )
+		cur = findChild(cur, *it);
+		if ( cur == 0 )
 			return false;
-		else
-			cur = cur->findChild(*it);
 		it++;
 	}
-	return cur->getPreorder();
+	return node(cur).getPreorder();
 }
 
-std::pair<std::vector<TrieNode*>,std::string> Trie::findPath( size_t p ) const {
+std::pair<std::vector<size_t>,std::string> Trie::findPath( size_t p ) const {
 	assert( finalized );
 	assert( p < nrNodes );
 	std::string s;
-	std::vector<TrieNode*> stack;
-	stack.push_back(root);
-	TrieNode* cur = stack.back();
-	TrieNode* next = nullptr;
-	while ( cur->getPreorder() != p ) {
-		assert(  cur->getPreorder() < p );
-		for (auto c : cur->getChildren()) {
-			if (c->getPreorder() <= p)
-				next = c;
-		}
-		assert( next != nullptr );
-		s.push_back(next->getContent());
+	std::vector<size_t> stack;
+	stack.push_back(0);
+	size_t cur = stack.back();
+	size_t next = 0;
+	while ( node(cur).getPreorder() != p ) {
+		assert(  node(cur).getPreorder() < p );
+		for ( size_t c = node(cur).getFirstChild(); c != 0 && node(c).getPreorder() <= p; c = node(c).getNextSibling() )
+			next = c;
+		assert( next != 0 );
+		s.push_back(node(next).getContent());
 		stack.push_back(next);
 		cur = next;
-		next = nullptr;
+		next = 0;
 	}
-	if (cur->getPreorder() == p)
+	if (node(cur).getPreorder() == p)
 		return std::make_pair(stack,s);
 	else
-		return std::make_pair(std::vector<TrieNode*>(),"");
+		return std::make_pair(std::vector<size_t>(),"");
 }
 
 std::unordered_map< size_t, std::vector<size_t> > Trie::computeLinks( std::unordered_map< size_t, std::vector<size_t> >& links ) {
@@ -498,26 +764,26 @@ std::unordered_map< size_t, std::vector<size_t> > Trie::computeLinks( std::unord
 	assert( finalized && order);
 
 	std::string s;
-	std::vector<TrieNode*> stack;
-	stack.push_back(root);
-	TrieNode* cur = stack.back();
-	TrieNode* next = nullptr;
+	std::vector<size_t> stack;
+	stack.push_back(0);
+	size_t cur = stack.back();
+	size_t next = 0;
 	for (size_t i = 1; i < nrNodes; i++) {
-		next = nullptr;
-		for (auto c : cur->getChildren()) {
-			if (c->getPreorder() == i) {
+		next = 0;
+		for ( size_t c = node(cur).getFirstChild(); c != 0; c = node(c).getNextSibling() ) {
+			if (node(c).getPreorder() == i) {
 				next = c;
 				break;
 			}
 		}
-		if (next == nullptr) {
-			std::pair<std::vector<TrieNode*>,std::string> tmp = findPath(i);
+		if (next == 0) {
+			std::pair<std::vector<size_t>,std::string> tmp = findPath(i);
 			stack = tmp.first;
 			s = tmp.second;
 			next = stack.back();
 			stack.pop_back();
-		} else 
-			s.push_back(next->getContent());
+		} else
+			s.push_back(node(next).getContent());
 
 		// compute links
 		for (size_t j = 1; j < s.size(); j++) {
@@ -525,7 +791,7 @@ std::unordered_map< size_t, std::vector<size_t> > Trie::computeLinks( std::unord
 			if (linkPartner == 0) continue;
 			if (links.find(linkPartner) == links.end())
 				links.insert(std::make_pair(linkPartner, std::vector<size_t>()));
-			const size_t linkEnd = stack.at(stack.size()-j)->getPreorder();
+			const size_t linkEnd = node(stack.at(stack.size()-j)).getPreorder();
 			if (linkEnd == 0) continue;;
 			links.find(linkPartner)->second.push_back(linkEnd);
 		}
@@ -542,17 +808,15 @@ TrieNode* Trie::findByPreorder(size_t p) {
 	if (!finalized) finalize();
 	assert(finalized);
 	assert( p < nrNodes );
-	TrieNode* cur = root;
-	TrieNode* next = nullptr;
-	while ( cur->getPreorder() != p ) {
-		assert(  cur->getPreorder() < p );
-		for (auto c : cur->getChildren()) {
-			if (c->getPreorder() <= p)
-				next = c;
-		}
-		assert( next != nullptr );
+	size_t cur = 0;
+	size_t next = 0;
+	while ( node(cur).getPreorder() != p ) {
+		assert(  node(cur).getPreorder() < p );
+		for ( size_t c = node(cur).getFirstChild(); c != 0 && node(c).getPreorder() <= p; c = node(c).getNextSibling() )
+			next = c;
+		assert( next != 0 );
 		cur = next;
-		next = nullptr;
+		next = 0;
 	}
-	return (cur->getPreorder() == p) ? cur : nullptr;
+	return (node(cur).getPreorder() == p) ? &node(cur) : nullptr;
 }
@@ -12,21 +12,18 @@
 
 #include "helpers.h"
 
+// node of the trie; children are kept in a list sorted by content, linked by index into the node arena of the trie (0 = none)
 class TrieNode {
 	private:
-		const char content;				// label of the edge from parent
-		bool end;							// true if a word ends at this node
-		std::vector<TrieNode*> children;	// list of children
+		char content;				// label of the edge from parent
+		bool end;					// true if a word ends at this node
+		size_t firstChild;
+		size_t nextSibling;
 		size_t preorder;
 		size_t postorder;
 		size_t parent_preorder;
 		size_t mass;
 
-		// MODIFICATION-TOLERANT BPM
-#ifdef MOD_TOLERANT
-		std::map<char,size_t> lastOcc;	// preorder label of last occurence of character i on path to root
-#endif
-
 	public:
 		TrieNode(char c);
 		~TrieNode();
@@ -35,35 +32,41 @@ class TrieNode {
 		void setPostorder(size_t p);
 		void setMass(size_t m);
 		void setParentPreorder(size_t p);
+		void setFirstChild(size_t i);
+		void setNextSibling(size_t i);
 		char getContent() const;
 		bool isWordEnd() const;
 		size_t getPreorder() const;
 		size_t getPostorder() const;
 		size_t getMass() const;
 		size_t getParentPreorder() const;
-		TrieNode* findChild(char c) const;
-		bool addChild(TrieNode* p);
-		std::vector<TrieNode*> getChildren() const;
-
-		// MODIFICATION-TOLERANT BPM
-#ifdef MOD_TOLERANT
- 		void setLastOcc( std::map<char,size_t> l );
-		const std::map<char,size_t>& getLastOcc() const;
-#endif
+		size_t getFirstChild() const;
+		size_t getNextSibling() const;
 };
 
 class Trie {
 	private:
-		TrieNode* root;
+		std::vector< std::vector<TrieNode> > blocks;	// node arena, node i is blocks[i / BLOCK_SIZE][i % BLOCK_SIZE], the root is node 0
 		size_t nrNodes;
+		size_t nrThreads;
 		std::map< std::string, size_t > proteinID;
 		std::map< size_t, std::string > idProtein;
+		std::vector< std::pair< size_t, std::array<size_t,2> > > wordEnds;	// node and <text position, length> of the first occurrence of each word
 	
 		bool finalized;
 		bool order;
 		bool mass;
 
-		void deleteNode(TrieNode* p);
+		TrieNode& node(size_t i);
+		const TrieNode& node(size_t i) const;
+		size_t newNode(char c);
+		void resize(size_t n);							// n nodes, the new nodes are not linked yet
+		size_t findChild(size_t p, char c) const;	// 0 if there is no such child
+		size_t addChild(size_t p, char c);			// return the (new) child with content c
+		std::vector<size_t> getSubtrees() const;	// children of the root, their subtrees are processed in parallel
+		size_t numberSubtree(size_t r);				// preorder and postorder relative to subtree r, return its size
+		void shiftSubtree(size_t r, size_t preOffset, size_t postOffset);
+		template<typename T> void addSortedSuffixes(const std::vector<T>& sa, const std::string& text, const std::vector< std::array<size_t,2> >& ranges, size_t maxLength);
 		void computeOrder();
 		void computeMass();
 		void finalize();
@@ -72,29 +75,39 @@ class Trie {
 		// MODIFICATION-TOLERANT BPM
 #ifdef MOD_TOLERANT
 		bool lastOcc;
+		std::vector<char> lastOccOrder;			// modified characters
+		std::vector<size_t> lastOccTable;		// preorder label of the last occurrence of lastOccOrder[j] on the path to the root, at preorder*lastOccOrder.size() + j
 		void computeLastOcc();
+		size_t getLastOcc( size_t preorder, char a ) const;
 #endif
 
 		// MUTATION-TOLERANT BPM
 #ifdef MUT_TOLERANT
-		std::pair<std::vector<TrieNode*>,std::string> findPath( size_t p ) const;
+		std::pair<std::vector<size_t>,std::string> findPath( size_t p ) const;
 		size_t findPreorder(std::string w) const; // find word w and output preorder
 #endif
 
 	public:
-		Trie();
+		Trie(size_t nrThreads = 1);	// threads used to build and annotate the trie
 		~Trie();
-		void add(std::string w, std::string protein);					// add word w at line l and pos p
+		void add(const std::string& w, const std::string& protein, size_t textPos = 0);	// add word w, which starts at textPos in the protein text
+		void addSuffixes(const std::string& text, const std::vector< std::array<size_t,2> >& ranges, size_t maxLength);	// add all suffixes of the ranges <text position, length> of text, truncated to maxLength, using a suffix array; the trie has to be empty
 		bool find(std::string w) const;				// find word w
 		size_t size() const;							// output number of nodes
 		std::map< size_t, std::vector< std::pair<size_t,size_t> > >& getNodesByMass(std::map< size_t, std::vector< std::pair<size_t,size_t> > >& t);	// return <preorder, postorder> for each node grouped by mass, calls finalize()
+		void getNodesByMass(std::vector<size_t>& masses, std::vector<size_t>& offsets, std::vector< std::pair<size_t,size_t> >& points);	// <preorder, postorder> for each node sorted by mass and preorder, the nodes of masses[i] are points[offsets[i]..offsets[i+1]), calls finalize()
 		std::vector< std::pair<size_t,size_t> > getLeaves() const; // return <preorder,postorder> for each trie node with wordEnd == true; assumes that computeOrder has been called
+		std::vector< std::pair<size_t,size_t> >& getOrder(std::vector< std::pair<size_t,size_t> >& res); // return <postorder,parent_preorder> for each node indexed by preorder, calls finalize()
+		TrieTable getTrieTable(size_t width); // as getOrder, with width bytes per value
+		std::map< size_t, std::string >& getLeafSeqs(std::map< size_t, std::string >& res) const; // return preorder->sequence for each trie node with wordEnd == true; assumes that computeOrder has been called
+		LeafTable getLeafTable(const std::string& text) const; // return the position in text of each trie node with wordEnd == true; assumes that computeOrder has been called
 		std::ostream& outputNodes(std::ostream&); // output <preorder,postorder,parent_preorder,isWordEnd() ? 0 : content,links,lastOcc-map> for each node
 		friend std::ostream& operator<<(std::ostream& stream, Trie& t);
 
 		// MODIFICATION-TOLERANT BPM
 #ifdef MOD_TOLERANT
 		std::map< size_t, std::map<char,size_t> > outputLastOcc(); // return map preorder->lastOcc
+		std::vector<size_t>& getLastOccTable(std::vector<char>& order, std::vector<size_t>& res); // return lastOcc of each node for the chars in order, indexed by preorder*order.size()
 #endif
 		// MUTATION-TOLERANT BPM
 #ifdef MUT_TOLERANT
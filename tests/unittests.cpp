@@ -24,6 +24,8 @@
 #include "../src/minmaxpst.h"
 #include "../src/helpers.h"
 #include "../src/fastaReader.h"
+#include "../src/indexFile.h"
+#include "../src/rangeTree.h"
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "../lib/doctest/doctest/doctest.h"
@@ -148,6 +150,58 @@ TEST_CASE("Trie tests") {
 		CHECK(points.find(12806)->second.size() == 2);
 		// mass (AGG) = 18508
 		CHECK(points.find(18508)->second.size() == 1);
+
+		// flat version, nodes of each mass sorted by preorder
+		std::vector<size_t> masses;
+		std::vector<size_t> offsets;
+		std::vector< MinMaxPST_Node > flat;
+		t.getNodesByMass(masses, offsets, flat);
+		CHECK( masses.size() == points.size() );
+		CHECK( offsets.size() == masses.size() + 1 );
+		CHECK( offsets.back() == t.size() );
+		for ( size_t i = 0; i < masses.size(); i++ ) {
+			std::vector< MinMaxPST_Node > group( flat.begin() + offsets[i], flat.begin() + offsets[i+1] );
+			CHECK( std::is_sorted(group.begin(), group.end()) );
+			std::sort( points[masses[i]].begin(), points[masses[i]].end() );
+			CHECK( group == points[masses[i]] );
+		}
+	}
+	SUBCASE("addSuffixes") {
+		// same trie as adding the substrings of the fasta reader one by one (in one thread)
+		for ( std::string file : { "tests/unittest.fasta", "tests/unittest2.fasta" } ) {
+			for ( size_t maxLength : { 5, 30, 60 } ) {
+				FastaReader f(file);
+				Trie u;
+				std::string text;
+				f.forEachPeptide(maxLength, [&u](const std::string& protein, const std::string& pep, size_t pos) {
+						u.add(pep, protein, pos - pep.size());
+					}, text);
+				Trie v(4);	// sharded by first char
+				std::string textV;
+				std::vector< std::array<size_t,2> > ranges;
+				f.forEachProtein([&ranges, maxLength](const std::string& protein, const std::string& seq, size_t pos) {
+						const std::array<size_t,2> range = {{ pos, FastaReader::getIndexedLength(seq.size(), maxLength) }};
+						ranges.push_back(range);
+					}, textV);
+				CHECK( textV == text );
+				v.addSuffixes(textV, ranges, maxLength);
+				CHECK( v.size() == u.size() );
+
+				std::vector< std::pair<size_t,size_t> > orderU, orderV;
+				CHECK( v.getOrder(orderV) == u.getOrder(orderU) );
+				CHECK( v.getLeaves() == u.getLeaves() );
+				std::map< size_t, std::vector< MinMaxPST_Node > > pointsU, pointsV;
+				CHECK( v.getNodesByMass(pointsV) == u.getNodesByMass(pointsU) );
+				const LeafTable leavesU = u.getLeafTable(text);
+				const LeafTable leavesV = v.getLeafTable(textV);
+				REQUIRE( leavesV.size() == leavesU.size() );
+				for ( size_t i = 0; i < leavesU.size(); i++ ) {
+					CHECK( leavesV.getDir()[i].preorder == leavesU.getDir()[i].preorder );
+					CHECK( leavesV.getDir()[i].offset == leavesU.getDir()[i].offset );
+					CHECK( leavesV.getDir()[i].length == leavesU.getDir()[i].length );
+				}
+			}
+		}
 	}
 #ifdef MOD_TOLERANT
 	SUBCASE("lastOccurence") {
@@ -327,8 +381,260 @@ TEST_CASE("Min-Max Priority Search Tree Tests") {
 		CHECK(p.first == 2);
 		CHECK(p.second == 6);
 	}
+
+	SUBCASE("view of external array") {
+		points.push_back( std::make_pair(2,6) );
+		points.push_back( std::make_pair(0,0) );
+		points.push_back( std::make_pair(1,2) );
+		points.push_back( std::make_pair(5,7) );
+		points.push_back( std::make_pair(3,4) );
+		points.push_back( std::make_pair(6,5) );
+		points.push_back( std::make_pair(7,3) );
+		points.push_back( std::make_pair(8,1) );
+		std::shared_ptr< std::vector<MinMaxPST_Node> > array = std::make_shared< std::vector<MinMaxPST_Node> >( MinMaxPST(points).getArray() );
+		MinMaxPST pst(array->data(), array->size(), sizeof(coord_t), array);
+		CHECK( pst.getArray() == *array );
+
+		MinMaxPST_Node p;
+		p = pst.leftmostNE( std::make_pair(2,2) );
+		CHECK(p.first == 2);
+		CHECK(p.second == 6);
+		p = pst.leftmostSE( std::make_pair(2,7) );
+		CHECK(p.first == 2);
+		CHECK(p.second == 6);
+	}
+
+	SUBCASE("blocked layout") {
+		std::mt19937 gen(3);
+		for ( size_t n = 0; n < 300; n += 7 ) {
+			points.clear();
+			for ( size_t i = 0; i < n; i++ )
+				points.push_back( std::make_pair(2*i+1, gen() % 1000) );
+			std::shuffle(points.begin(), points.end(), gen);
+			std::vector<bool> used(n, false);
+			for ( size_t i = 1; i <= n; i++ ) {
+				const size_t pos = BasicMinMaxPST<uint32_t>::blockedPosition(i, n);
+				REQUIRE( pos < n );
+				CHECK( !used[pos] );
+				used[pos] = true;
+			}
+			for ( size_t width : { sizeof(uint32_t), sizeof(uint64_t) } ) {
+				const MinMaxPST heap(points, width);
+				const MinMaxPST blocked(points, width, PST_LAYOUT_BLOCKED);
+				CHECK( blocked.getLayout() == PST_LAYOUT_BLOCKED );
+				CHECK( blocked.getArray() == heap.getArray() );
+				for ( size_t q = 0; q < 20; q++ ) {
+					const MinMaxPST_Node o = std::make_pair( gen() % (2*n+2), gen() % 1000 );
+					CHECK( blocked.leftmostNE(o) == heap.leftmostNE(o) );
+					CHECK( blocked.leftmostSE(o) == heap.leftmostSE(o) );
+					CHECK( blocked.enumerateUp(o.first, 2*n, o.second) == heap.enumerateUp(o.first, 2*n, o.second) );
+				}
+			}
+		}
+	}
+
+	SUBCASE("build and buildBySorting give the same order") {
+		std::mt19937 gen(42);
+		for ( size_t n = 0; n < 300; n++ ) {
+			// random permutation as y coordinates, and y coordinates with ties
+			for ( size_t range : { n, n/4+1 } ) {
+				std::vector< BasicMinMaxPST<uint32_t>::Node > a;
+				std::vector<uint32_t> y(n);
+				for ( size_t i = 0; i < n; i++ )
+					y[i] = (range == n) ? i : gen() % range;
+				std::shuffle(y.begin(), y.end(), gen);
+				for ( size_t i = 0; i < n; i++ )
+					a.push_back( std::make_pair(static_cast<uint32_t>(i), y[i]) );
+				std::shuffle(a.begin(), a.end(), gen);
+				std::vector< BasicMinMaxPST<uint32_t>::Node > b = a;
+				BasicMinMaxPST<uint32_t>::build(a);
+				BasicMinMaxPST<uint32_t>::buildBySorting(b);
+				CHECK( a == b );
+			}
+		}
+	}
+
+	SUBCASE("enumerateUp and enumerateDown") {
+		std::mt19937 gen(7);
+		for ( size_t n = 0; n < 100; n++ ) {
+			points.clear();
+			for ( size_t i = 0; i < n; i++ )
+				points.push_back( std::make_pair(2*i+1, gen() % 50) );
+			std::shuffle(points.begin(), points.end(), gen);
+			MinMaxPST pst(points);
+			for ( size_t q = 0; q < 20; q++ ) {
+				const size_t x0 = gen() % (2*n+2), x1 = x0 + gen() % (2*n+2), y = gen() % 52;
+				std::vector< MinMaxPST_Node > up, down;
+				for ( auto p : points ) {
+					if ( x0 <= p.first && p.first <= x1 && p.second >= y )
+						up.push_back(p);
+					if ( x0 <= p.first && p.first <= x1 && p.second <= y )
+						down.push_back(p);
+				}
+				std::sort(up.begin(), up.end());
+				std::sort(down.begin(), down.end());
+				CHECK( pst.enumerateUp(x0, x1, y) == down );
+				CHECK( pst.enumerateDown(x0, x1, y) == up );
+			}
+		}
+	}
+
+	SUBCASE("batched enumerateUp") {
+		std::mt19937 gen(13);
+		for ( size_t n = 0; n < 100; n++ ) {
+			points.clear();
+			for ( size_t i = 0; i < n; i++ )
+				points.push_back( std::make_pair(2*i+1, gen() % 50) );
+			std::shuffle(points.begin(), points.end(), gen);
+			MinMaxPST pst(points);
+			std::vector< MinMaxPST_Node > queries;
+			for ( size_t q = 0; q < 20; q++ )
+				queries.push_back( std::make_pair(gen() % (2*n+2), gen() % 52) );
+			const std::vector< std::vector< MinMaxPST_Node > > res = pst.enumerateUp(queries);
+			REQUIRE( res.size() == queries.size() );
+			for ( size_t q = 0; q < queries.size(); q++ )
+				CHECK( res[q] == pst.enumerateUp(queries[q].first, pst.getPosINF(), queries[q].second) );
+		}
+	}
+
+	SUBCASE("quadrant and three-sided queries against brute force") {
+		std::mt19937 gen(11);
+		const coord_t inf = std::numeric_limits<coord_t>::max();
+		for ( size_t n = 0; n < 150; n++ ) {
+			// distinct x and distinct y coordinates with gaps
+			std::vector<coord_t> y(n);
+			for ( size_t i = 0; i < n; i++ )
+				y[i] = 2*i+1;
+			std::shuffle(y.begin(), y.end(), gen);
+			points.clear();
+			for ( size_t i = 0; i < n; i++ )
+				points.push_back( std::make_pair(2*i+1, y[i]) );
+			std::shuffle(points.begin(), points.end(), gen);
+			MinMaxPST pst(points);
+
+			// best point of the points in [x0,x1] x [y0,y1] by key (smaller is better), or none
+			auto oracle = [&](coord_t x0, coord_t x1, coord_t y0, coord_t y1, std::function<coord_t(const MinMaxPST_Node&)> key, MinMaxPST_Node none) {
+				MinMaxPST_Node res = none;
+				bool found = false;
+				for ( auto p : points ) {
+					if ( x0 <= p.first && p.first <= x1 && y0 <= p.second && p.second <= y1 && (!found || key(p) < key(res)) ) {
+						res = p;
+						found = true;
+					}
+				}
+				return res;
+			};
+			auto left = [](const MinMaxPST_Node& p) { return p.first; };
+			auto right = [inf](const MinMaxPST_Node& p) { return inf - p.first; };
+			auto low = [](const MinMaxPST_Node& p) { return p.second; };
+			auto high = [inf](const MinMaxPST_Node& p) { return inf - p.second; };
+			for ( size_t q = 0; q < 30; q++ ) {
+				const MinMaxPST_Node o = std::make_pair( gen() % (2*n+2), gen() % (2*n+2) );
+				CHECK( pst.leftmostNE(o) == oracle(o.first, inf, o.second, inf, left, std::make_pair(inf,inf)) );
+				CHECK( pst.leftmostSE(o) == oracle(o.first, inf, 0, o.second, left, std::make_pair(inf,0)) );
+				CHECK( pst.rightmostNW(o) == oracle(0, o.first, o.second, inf, right, std::make_pair(0,inf)) );
+				CHECK( pst.rightmostSW(o) == oracle(0, o.first, 0, o.second, right, std::make_pair(0,0)) );
+				CHECK( pst.highestNE(o) == oracle(o.first, inf, o.second, inf, high, std::make_pair(inf,inf)) );
+				CHECK( pst.highestNW(o) == oracle(0, o.first, o.second, inf, high, std::make_pair(0,inf)) );
+				CHECK( pst.lowestSE(o) == oracle(o.first, inf, 0, o.second, low, std::make_pair(inf,0)) );
+				CHECK( pst.lowestSW(o) == oracle(0, o.first, 0, o.second, low, std::make_pair(0,0)) );
+				const coord_t x0 = gen() % (2*n+2), x1 = x0 + gen() % (2*n+2);
+				CHECK( pst.lowest3SideUp(x0, x1, o.second) == oracle(x0, x1, 0, o.second, low, std::make_pair(inf,0)) );
+				CHECK( pst.highest3SideDown(x0, x1, o.second) == oracle(x0, x1, o.second, inf, high, std::make_pair(inf,inf)) );
+			}
+		}
+	}
 }
 
+TEST_CASE("Range tree") {
+	std::mt19937 gen(17);
+	for ( size_t n = 0; n < 100; n++ ) {
+		CHECK( BasicRangeTree<uint32_t>::sizeOfArray( BasicRangeTree<uint32_t>::arraySize(n) ) == n );
+		// distinct y coordinates, so that the highest and lowest points are unique
+		std::vector< MinMaxPST_Node > points;
+		for ( size_t i = 0; i < n; i++ )
+			points.push_back( std::make_pair(2*i+1, 2*i+1) );
+		std::shuffle(points.begin(), points.end(), gen);
+		for ( size_t i = 0; i < n; i++ )
+			std::swap( points[i].second, points[gen() % n].second );
+		MinMaxPST pst(points);
+		for ( size_t width : { sizeof(uint32_t), sizeof(uint64_t) } ) {
+			const MinMaxPST tree(points, width, PST_LAYOUT_RANGE_TREE);
+			CHECK( tree.size() == n );
+			CHECK( tree.getLayout() == PST_LAYOUT_RANGE_TREE );
+			std::vector< MinMaxPST_Node > sorted(points);
+			std::sort(sorted.begin(), sorted.end());
+			CHECK( tree.getArray() == sorted );
+			std::vector< MinMaxPST_Node > queries;
+			for ( size_t q = 0; q < 20; q++ ) {
+				const MinMaxPST_Node o = std::make_pair(gen() % (2*n+2), gen() % (2*n+2));
+				const size_t x1 = o.first + gen() % (2*n+2);
+				CHECK( tree.leftmostNE(o) == pst.leftmostNE(o) );
+				CHECK( tree.rightmostNW(o) == pst.rightmostNW(o) );
+				CHECK( tree.highestNE(o) == pst.highestNE(o) );
+				CHECK( tree.highestNW(o) == pst.highestNW(o) );
+				CHECK( tree.leftmostSE(o) == pst.leftmostSE(o) );
+				CHECK( tree.rightmostSW(o) == pst.rightmostSW(o) );
+				CHECK( tree.lowestSE(o) == pst.lowestSE(o) );
+				CHECK( tree.lowestSW(o) == pst.lowestSW(o) );
+				CHECK( tree.lowest3SideUp(o.first, x1, o.second) == pst.lowest3SideUp(o.first, x1, o.second) );
+				CHECK( tree.highest3SideDown(o.first, x1, o.second) == pst.highest3SideDown(o.first, x1, o.second) );
+				CHECK( tree.enumerateUp(o.first, x1, o.second) == pst.enumerateUp(o.first, x1, o.second) );
+				CHECK( tree.enumerateDown(o.first, x1, o.second) == pst.enumerateDown(o.first, x1, o.second) );
+				CHECK( tree.enumerateUp(o.first, pst.getPosINF(), o.second) == pst.enumerateUp(o.first, pst.getPosINF(), o.second) );
+				queries.push_back(o);
+			}
+			std::sort(queries.begin(), queries.end());
+			CHECK( tree.enumerateUp(queries) == pst.enumerateUp(queries) );
+
+			// view of the array, as mapped from an index file
+			std::shared_ptr<const void> storage;
+			const MinMaxPST view(tree.data(), MinMaxPST::sizeOfArray(MinMaxPST::arraySize(n, PST_LAYOUT_RANGE_TREE), PST_LAYOUT_RANGE_TREE), width, storage, PST_LAYOUT_RANGE_TREE);
+			CHECK( view.getArray() == sorted );
+			CHECK( view.enumerateUp(0, pst.getPosINF(), n) == pst.enumerateUp(0, pst.getPosINF(), n) );
+		}
+	}
+}
+
+TEST_CASE("Mass directory") {
+	std::vector< MinMaxPST_Node > points;
+	points.push_back( std::make_pair(1,2) );
+	points.push_back( std::make_pair(2,1) );
+	MassDirectory psts;
+	CHECK( psts.empty() );
+	CHECK( psts.find(5702) == nullptr );
+
+	SUBCASE("dense masses") {
+		psts.add( 5702, MinMaxPST(points) );
+		psts.add( 7104, MinMaxPST(points) );
+		psts.add( 12806, MinMaxPST(points) );
+		CHECK( psts.size() == 3 );
+		CHECK( psts.find(7104) == &psts.getPST(1) );
+		CHECK( psts.find(12806) == &psts.getPST(2) );
+		CHECK( psts.find(0) == nullptr );
+		CHECK( psts.find(7105) == nullptr );
+		CHECK( psts.find(12807) == nullptr );
+		CHECK( psts.contains(7104) );
+		CHECK( !psts.contains(7105) );
+		CHECK( !psts.contains(0) );
+		CHECK( !psts.contains(1 << 30) );
+		CHECK( psts.containsRange(7000, 7104) );
+		CHECK( !psts.containsRange(7105, 12805) );
+		CHECK( psts.containsRange(12806, 1 << 30) );
+	}
+
+	SUBCASE("sparse masses") {
+		psts.add( 5702, MinMaxPST(points) );
+		psts.add( 5702 + (size_t(1) << 30), MinMaxPST(points) );
+		psts.add( 5703 + (size_t(1) << 30), MinMaxPST(points) );
+		CHECK( psts.find(5702) == &psts.getPST(0) );
+		CHECK( psts.find(5703 + (size_t(1) << 30)) == &psts.getPST(2) );
+		CHECK( psts.find(5703) == nullptr );
+		CHECK( psts.getMass(1) == 5702 + (size_t(1) << 30) );
+		CHECK( psts.contains(5703 + (size_t(1) << 30)) );
+		CHECK( !psts.contains(5703) );
+	}
+}
 
 TEST_CASE("Block pattern matching tests") {
 	std::ifstream infile("tests/unittest.db");
@@ -341,9 +647,9 @@ TEST_CASE("Block pattern matching tests") {
 	}
 	std::map< size_t, std::vector< MinMaxPST_Node > > points;
 	t.getNodesByMass(points);
-	std::map< size_t, MinMaxPST > psts;
+	MassDirectory psts;
 	for ( auto m : points )
-		psts.insert( std::make_pair( m.first, MinMaxPST(m.second) ));
+		psts.add( m.first, MinMaxPST(m.second) );
 
 	const size_t nrPatterns = 10;
 	const size_t patternLength = 10;
@@ -361,19 +667,401 @@ TEST_CASE("Block pattern matching tests") {
 		
 		CHECK( findBP(bp,psts).size() > 0);
 	}
+
+	SUBCASE("batch with common leading blocks") {
+		std::vector< std::vector<size_t> > bps;
+		std::ifstream infile3("tests/unittest.db");
+		while (std::getline(infile3, line) && bps.size() < 40) {
+			if (line.size() < 8)
+				continue;
+			// the pattern, its prefixes, a variant with merged last blocks, and a copy
+			std::vector<size_t> p;
+			for ( size_t j = 2; j < line.size() && p.size() < 4; j+=2) {
+				p.push_back( getMass(line.substr(j-2,2)) );
+				bps.push_back(p);
+			}
+			bps.push_back( std::vector<size_t>(p.begin(), p.end()-2) );
+			bps.back().push_back( p[2] + p[3] );
+			bps.push_back(p);
+		}
+		bps.push_back( std::vector<size_t>() );
+		bps.push_back( std::vector<size_t>(1, 1) );
+		const std::vector< std::vector<size_t> > res = findBPBatch(bps, psts);
+		REQUIRE( res.size() == bps.size() );
+		for ( size_t i = 0; i < bps.size(); i++ )
+			CHECK( res[i] == findBP(bps[i], psts) );
+		const std::vector< std::vector<size_t> > part = findBPBatch(bps, 5, 12, psts);
+		REQUIRE( part.size() == 7 );
+		for ( size_t i = 5; i < 12; i++ )
+			CHECK( part[i-5] == res[i] );
+
+		// the visitor sees the patterns in input order, and stopping one pattern does not stop the others
+		std::vector< std::pair<size_t,size_t> > visited;
+		findBPBatch(bps, 0, bps.size(), psts, [&visited](size_t p, size_t v) { visited.push_back(std::make_pair(p,v)); return true; });
+		std::vector< std::pair<size_t,size_t> > expected;
+		for ( size_t i = 0; i < bps.size(); i++ )
+			for ( auto v : res[i] )
+				expected.push_back(std::make_pair(i,v));
+		CHECK( visited == expected );
+		visited.clear();
+		findBPBatch(bps, 0, bps.size(), psts, [&visited](size_t p, size_t v) { visited.push_back(std::make_pair(p,v)); return false; });
+		expected.clear();
+		for ( size_t i = 0; i < bps.size(); i++ )
+			if (!res[i].empty())
+				expected.push_back(std::make_pair(i,res[i].front()));
+		CHECK( visited == expected );
+	}
+
+	SUBCASE("frontier cache") {
+		std::vector< std::vector<size_t> > bps;
+		std::ifstream infile3("tests/unittest.db");
+		while (std::getline(infile3, line) && bps.size() < 60) {
+			if (line.size() < 10)
+				continue;
+			// patterns that differ in their last blocks only
+			std::vector<size_t> p;
+			for ( size_t j = 2; j < line.size() && p.size() < 5; j+=2)
+				p.push_back( getMass(line.substr(j-2,2)) );
+			bps.push_back(p);
+			bps.push_back( std::vector<size_t>(p.begin(), p.end()-1) );
+			bps.push_back( std::vector<size_t>(p.begin(), p.end()-2) );
+			bps.back().push_back( p[3] + p[4] );
+		}
+		std::vector< std::vector<size_t> > expected;
+		for ( auto& bp : bps )
+			expected.push_back( findBP(bp, psts) );
+		for ( size_t capacity : { 1000000, 20 } ) {
+			FrontierCache cache(capacity);
+			for ( size_t pass = 0; pass < 2; pass++ ) {
+				for ( size_t i = 0; i < bps.size(); i++ ) {
+					std::vector<size_t> res;
+					findBP(bps[i], psts, [&res](size_t v) { res.push_back(v); return true; }, &cache);
+					CHECK( res == expected[i] );
+				}
+				const std::vector< std::vector<size_t> > batch = findBPBatch(bps, 0, bps.size(), psts, &cache);
+				CHECK( batch == expected );
+				CHECK( cache.getNodes() <= capacity );
+			}
+			CHECK( cache.getHits() > 0 );
+		}
+
+		// the least recently used entry is dropped first
+		FrontierCache cache(16);
+		const FrontierCache::Frontier f(2, std::make_pair(1,1));
+		const std::vector<size_t> masses = { 10, 20, 30 };
+		size_t length = 0;
+		cache.put(masses, 1, f);
+		cache.put(masses, 2, f);
+		CHECK( cache.longest(masses, 1, 1, length) != nullptr );
+		cache.put(masses, 3, f);
+		for ( size_t m : { 5, 6, 7 } )
+			cache.put({ m }, 1, f);
+		CHECK( cache.size() == 5 );
+		CHECK( cache.getNodes() == 15 );
+		cache.put({ 8 }, 1, FrontierCache::Frontier(100, std::make_pair(1,1)));	// larger than an eighth
+		CHECK( cache.size() == 5 );
+		CHECK( cache.longest(masses, 1, 3, length) != nullptr );
+		CHECK( length == 3 );
+		CHECK( cache.longest(masses, 2, 2, length) == nullptr );
+		CHECK( length == 0 );
+		CHECK( cache.longest(masses, 1, 2, length) != nullptr );
+		CHECK( length == 1 );
+	}
+
+	SUBCASE("visitor and early termination") {
+		// short patterns with many matches
+		const std::string aa = "ACDEGKLPS";
+		for ( size_t i = 0; i < aa.size(); i++ )
+			for ( size_t j = 0; j < aa.size(); j++ ) {
+				std::vector<size_t> p = { getMass(aa.substr(i,1)), getMass(aa.substr(j,1)) };
+				const std::vector<size_t> all = findBP(p, psts);
+				std::vector<size_t> visited;
+				findBP(p, psts, [&visited](size_t v) { visited.push_back(v); return true; });
+				CHECK( visited == all );
+				visited.clear();
+				findBP(p, psts, [&visited](size_t v) { visited.push_back(v); return visited.size() < 3; });
+				CHECK( visited.size() == std::min<size_t>(3, all.size()) );
+				CHECK( std::equal(visited.begin(), visited.end(), all.begin()) );
+				// the tolerant search passes on the matches in the order of its result vector as well
+				const MassTolerance tol = { 2000, 0 };
+				const std::vector<size_t> tolerant = findBP(p, psts, tol);
+				visited.clear();
+				findBP(p, psts, tol, [&visited](size_t v) { visited.push_back(v); return true; });
+				CHECK( visited == tolerant );
+				visited.clear();
+				findBP(p, psts, tol, [&visited](size_t v) { visited.push_back(v); return visited.size() < 3; });
+				CHECK( visited.size() == std::min<size_t>(3, tolerant.size()) );
+				CHECK( std::equal(visited.begin(), visited.end(), tolerant.begin()) );
+			}
+	}
+
+	SUBCASE("characters of mass 0") {
+		// X has mass 0, so a mass repeats on a path (G and GX); only the topmost node of a mass is matched
+		cfg::loadConfig("cfg/aminoacids.cfg","cfg/modifications.cfg");
+		REQUIRE( getMass("X") == 0 );
+		Trie u;
+		for ( std::string w : { "GXAVV", "GAXXAGVS", "GAVSXA" } )
+			for ( size_t i = 0; i < w.size(); i++ )
+				u.add(w.substr(i), "");
+		std::map< size_t, std::vector< MinMaxPST_Node > > nodes;
+		u.getNodesByMass(nodes);
+		MassDirectory dir;
+		std::vector< std::pair< MinMaxPST_Node, size_t > > all;	// <preorder, postorder>, mass
+		for ( auto m : nodes ) {
+			dir.add( m.first, MinMaxPST(m.second) );
+			for ( auto v : m.second )
+				all.push_back( std::make_pair(v, m.first) );
+		}
+		std::sort(all.begin(), all.end());
+
+		// G|A is matched by GA and GXA, each once
+		std::vector<size_t> p = { getMass("G"), getMass("A") };
+		CHECK( findBP(p, dir).size() == 2 );
+
+		// nodes of the last prefix mass without an ancestor of that mass, with an ancestor of each other prefix mass
+		const std::vector<std::string> blocks = { "G", "A", "V", "S", "GA", "AG", "VS", "AVV" };
+		std::vector< std::vector<size_t> > bps;
+		std::vector< std::vector<size_t> > expected;
+		for ( size_t n = 1; n <= 3; n++ ) {
+			std::vector<size_t> k(n, 0);
+			while (k[0] < blocks.size()) {
+				std::vector<size_t> bp, masses;
+				for ( auto i : k ) {
+					bp.push_back( getMass(blocks[i]) );
+					masses.push_back( (masses.empty() ? 0 : masses.back()) + bp.back() );
+				}
+				std::vector<size_t> res;
+				for ( auto& v : all ) {
+					if (v.second != masses.back())
+						continue;
+					std::set<size_t> above;
+					for ( auto& a : all )
+						if (a.first.first < v.first.first && a.first.second > v.first.second)
+							above.insert(a.second);
+					bool match = above.count(masses.back()) == 0;
+					for ( size_t d = 0; d+1 < masses.size(); d++ )
+						match = match && above.count(masses[d]) > 0;
+					if (match)
+						res.push_back(v.first.first);
+				}
+				bps.push_back(bp);
+				expected.push_back(res);
+				for ( size_t d = n; d-- > 0; ) {
+					if (++k[d] < blocks.size() || d == 0)
+						break;
+					k[d] = 0;
+				}
+			}
+		}
+		FrontierCache cache(1000000);
+		for ( size_t i = 0; i < bps.size(); i++ ) {
+			CHECK( findBP(bps[i], dir) == expected[i] );
+			std::vector<size_t> res;
+			findBP(bps[i], dir, [&res](size_t v) { res.push_back(v); return true; }, &cache);
+			CHECK( res == expected[i] );
+		}
+		CHECK( findBPBatch(bps, dir) == expected );
+		CHECK( findBPBatch(bps, 0, bps.size(), dir, &cache) == expected );
+
+		// with a tolerance wider than G, the window of a prefix mass holds nested nodes; each match is reported once
+		MassTolerance tol = { 6000, 0 };
+		for ( auto& bp : bps ) {
+			std::vector< MinMaxPST_Node > matched( 1, std::make_pair(0, std::numeric_limits<coord_t>::max()) );
+			size_t mass = 0;
+			for ( auto b : bp ) {
+				mass += b;
+				std::vector< MinMaxPST_Node > next;
+				for ( auto& v : all ) {
+					if ( v.second + tol.absolute < mass || v.second > mass + tol.absolute )
+						continue;
+					bool below = false;
+					bool topmost = true;
+					for ( auto& u : matched )
+						below = below || (v.first.first > u.first && v.first.second < u.second);
+					for ( auto& a : all )
+						if (a.second == v.second && a.first.first < v.first.first && a.first.second > v.first.second)
+							topmost = false;
+					if (below && topmost)
+						next.push_back(v.first);
+				}
+				matched.swap(next);
+			}
+			std::vector<size_t> res;
+			for ( auto v : matched )
+				res.push_back(v.first);
+			CHECK( findBP(bp, dir, tol) == res );
+		}
+	}
+
+	SUBCASE("search from the most selective block") {
+		// 24 nodes of mass(ACDE), one of mass(ACDEW)
+		std::string w = "ACDE";
+		Trie u;
+		do {
+			u.add(w + "K", "");
+		} while (std::next_permutation(w.begin(), w.end()));
+		u.add("ACDEW", "");
+		std::map< size_t, std::vector< MinMaxPST_Node > > nodes;
+		u.getNodesByMass(nodes);
+		MassDirectory dir;
+		for ( auto m : nodes )
+			dir.add( m.first, MinMaxPST(m.second) );
+		std::vector<size_t> p = { getMass("ACDE"), getMass("W") };
+		REQUIRE( dir.find(p[0]) != nullptr );
+		REQUIRE( dir.find(p[0]+p[1]) != nullptr );
+		CHECK( planAnchor({ dir.find(p[0]), dir.find(p[0]+p[1]) }) == 1 );
+		CHECK( planAnchor({ dir.find(p[0]+p[1]), dir.find(p[0]) }) == 0 );
+		std::vector<size_t> res = findBP(p, dir);
+		REQUIRE( res.size() == 1 );
+		CHECK( u.findByPreorder(res[0])->getPostorder() == dir.find(p[0]+p[1])->getArray()[0].second );
+		// the node of mass(ACDEW) is not below a node of mass(CDE)
+		p = { getMass("CDE"), getMass("AW") };
+		CHECK( findBP(p, dir).empty() );
+		p = { getMass("A"), getMass("CDEW") };
+		CHECK( findBP(p, dir).size() == 1 );
+	}
+
+	SUBCASE("mass tolerance") {
+		MassTolerance tol;
+		CHECK( readMassTolerance("10ppm", tol) );
+		CHECK( (tol.absolute == 0 && tol.ppm == 10) );
+		CHECK( tol.at(2000000) == 20 );
+		CHECK( readMassTolerance("150", tol) );
+		CHECK( (tol.absolute == 150 && tol.ppm == 0) );
+		CHECK( !readMassTolerance("ppm", tol) );
+		CHECK( !readMassTolerance("1.5", tol) );
+		CHECK( psts.lowerBound(0) == 0 );
+		CHECK( psts.lowerBound(psts.getMass(3)) == 3 );
+		CHECK( psts.lowerBound(psts.getMass(3)+1) == 4 );
+
+		std::ifstream infile3("tests/unittest.db");
+		size_t nrPatterns = 0;
+		while (std::getline(infile3, line) && nrPatterns < 10) {
+			if (line.size() < 6)
+				continue;
+			nrPatterns++;
+			bp.clear();
+			for ( size_t j = 2; j < line.size() && bp.size() < 3; j+=2)
+				bp.push_back( getMass(line.substr(j-2,2)) );
+			for ( size_t t : { 0, 1, 2000, 8000 } ) {
+				tol.absolute = t;
+				tol.ppm = 0;
+				// brute force: nodes below a node matched before with a mass in the window of the prefix mass
+				std::vector< MinMaxPST_Node > matched( 1, std::make_pair(0, std::numeric_limits<coord_t>::max()) );
+				size_t mass = 0;
+				for ( auto b : bp ) {
+					mass += b;
+					std::vector< MinMaxPST_Node > next;
+					for ( auto& m : points ) {
+						if ( m.first + t < mass || m.first > mass + t )
+							continue;
+						for ( auto v : m.second )
+							for ( auto u : matched )
+								if ( v.first > u.first && v.second < u.second ) {
+									next.push_back(v);
+									break;
+								}
+					}
+					std::sort(next.begin(), next.end());
+					matched.swap(next);
+				}
+				std::vector<size_t> expected;
+				for ( auto v : matched )
+					expected.push_back(v.first);
+				CHECK( findBP(bp, psts, tol) == expected );
+			}
+		}
+
+		// a node in the windows of two consecutive prefix masses is not below itself, and neither is the root
+		cfg::loadConfig("cfg/aminoacids.cfg","cfg/modifications.cfg");
+		Trie u;
+		u.add("GG", "");
+		u.add("AG", "");
+		std::map< size_t, std::vector< MinMaxPST_Node > > nodes;
+		u.getNodesByMass(nodes);
+		MassDirectory dir;
+		for ( auto m : nodes )
+			dir.add( m.first, MinMaxPST(m.second) );
+		tol = { 6000, 0 };
+		bp = { getMass("G"), getMass("G") };
+		std::vector<size_t> expected;	// GG and AG, not G
+		for ( auto v : u.getLeaves() )
+			expected.push_back(v.first);
+		std::sort(expected.begin(), expected.end());
+		CHECK( findBP(bp, dir, tol) == expected );
+		bp = { getMass("G") };
+		for ( auto v : findBP(bp, dir, tol) )
+			CHECK( v > 0 );
+	}
 }
 
 
+TEST_CASE("count-only matching") {
+	cfg::loadConfig("cfg/aminoacids.cfg","cfg/modifications.cfg");
+	MassDirectory psts;
+	MinMaxPST* leaves = nullptr;
+	TrieTable trie;
+	LeafTable leafSeqs;
+	readDBFile("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs);
+
+	// against the leaves in the quadrant of each node; the subtree is the preorder range up to the first node after it in postorder
+	for ( size_t v = 0; v < trie.size(); v++ ) {
+		CHECK( countLeaves(v, trie, leafSeqs) == leaves->enumerateUp(v, leaves->getPosINF(), trie.at(v).first).size() );
+		const size_t end = v + trie.subtreeSize(v);
+		REQUIRE( end <= trie.size() );
+		CHECK( trie.at(end-1).first <= trie.at(v).first );
+		if (end < trie.size())
+			CHECK( trie.at(end).first > trie.at(v).first );
+	}
+	CHECK( trie.subtreeSize(0) == trie.size() );
+
+	// against a brute force over the sequences of all nodes: a node matches if its sequence has the mass of the whole
+	// pattern, no shorter prefix has it, and some prefix has the mass of each leading part; its leaves are the leaves
+	// whose sequence starts with it
+	std::vector<std::string> seqs;
+	std::vector<std::string> leafStrings;
+	for ( size_t v = 0; v < trie.size(); v++ ) {
+		seqs.push_back( getProteins({v,trie.at(v).first}, *leaves, trie, leafSeqs) );
+		if (leafSeqs.contains(v))
+			leafStrings.push_back( seqs.back() );
+	}
+	std::vector< std::vector<size_t> > bps = { { 7104 }, { 7104, 7104 }, { 11308, 11308 }, { 32321, 48420 }, { 1 } };
+	for ( auto& bp : bps ) {
+		MatchCount expected = { 0, 0 };
+		for ( auto& seq : seqs ) {
+			std::set<size_t> prefixMasses;
+			for ( size_t k = 1; k < seq.size(); k++ )
+				prefixMasses.insert( getMass(seq.substr(0,k)) );
+			size_t mass = 0;
+			bool match = !seq.empty();
+			for ( size_t j = 0; j+1 < bp.size(); j++ ) {
+				mass += bp[j];
+				match = match && prefixMasses.count(mass) > 0;
+			}
+			mass += bp.back();
+			if (!match || getMass(seq) != mass || prefixMasses.count(mass) > 0)
+				continue;
+			expected.matches++;
+			for ( auto& l : leafStrings )
+				if (l.compare(0, seq.size(), seq) == 0)
+					expected.leaves++;
+		}
+		const MatchCount c = countBP(bp, psts, trie, leafSeqs);
+		CHECK( c.matches == expected.matches );
+		CHECK( c.leaves == expected.leaves );
+	}
+	CHECK( countBP(bps[0], psts, trie, leafSeqs).leaves > 1 );
+}
+
 #ifdef MOD_TOLERANT
 TEST_CASE("modification-tolerant BPM") {
 	SUBCASE("one PTM start") {
 		cfg::loadConfig("cfg/aminoacids.cfg","tests/mod2.cfg");
-		std::map< size_t, MinMaxPST > psts;
+		MassDirectory psts;
 		MinMaxPST* leaves = nullptr;
-		std::vector< std::pair<size_t,size_t> > trie;
-		std::map< size_t, std::string > leafSeqs;
-		std::unordered_map< size_t, std::vector<size_t> > links;
-		std::map<size_t,std::map<char,size_t>> lastOcc;
+		TrieTable trie;
+		LeafTable leafSeqs;
+		LastOccTable lastOcc;
 		readDBFileMod("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs, lastOcc);
 
 		std::vector<size_t> bp = {
@@ -391,16 +1079,34 @@ TEST_CASE("modification-tolerant BPM") {
 		};
 		res = findBPMod(bp,psts,trie,lastOcc);
 		CHECK(res.size() == 0);
+
+		// the visitor sees the same matches and can stop the search
+		bp = { 12806 };		// GA or AG
+		res = findBPMod(bp,psts,trie,lastOcc);
+		REQUIRE(res.size() > 0);
+		std::vector<size_t> visited;
+		findBPMod(bp,psts,trie,lastOcc, [&visited](size_t v) { visited.push_back(v); return true; });
+		CHECK(visited == res);
+		visited.clear();
+		findBPMod(bp,psts,trie,lastOcc, [&visited](size_t v) { visited.push_back(v); return false; });
+		CHECK(visited == std::vector<size_t>(1, res.front()));
+
+		// prefix masses with and without modification are checked before the search
+		std::vector<size_t> masses = { 35720+4321, 35720+4321+28117 };
+		CHECK( modifiedMassesInIndex(masses, psts) );
+		masses = { 35720, 35720+28117 };
+		CHECK( modifiedMassesInIndex(masses, psts) );
+		masses = { 35720+4321+1, 35720+4321+28117 };
+		CHECK( !modifiedMassesInIndex(masses, psts) );
 	}
 
 	SUBCASE("one PTM mid") {
 		cfg::loadConfig("cfg/aminoacids.cfg","tests/mod1.cfg");
-		std::map< size_t, MinMaxPST > psts;
+		MassDirectory psts;
 		MinMaxPST* leaves = nullptr;
-		std::vector< std::pair<size_t,size_t> > trie;
-		std::map< size_t, std::string > leafSeqs;
-		std::unordered_map< size_t, std::vector<size_t> > links;
-		std::map<size_t,std::map<char,size_t>> lastOcc;
+		TrieTable trie;
+		LeafTable leafSeqs;
+		LastOccTable lastOcc;
 		readDBFileMod("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs, lastOcc);
 
 		std::vector<size_t> bp = {
@@ -417,12 +1123,11 @@ TEST_CASE("modification-tolerant BPM") {
 
 	SUBCASE("one PTM end") {
 		cfg::loadConfig("cfg/aminoacids.cfg","tests/mod2.cfg");
-		std::map< size_t, MinMaxPST > psts;
+		MassDirectory psts;
 		MinMaxPST* leaves = nullptr;
-		std::vector< std::pair<size_t,size_t> > trie;
-		std::map< size_t, std::string > leafSeqs;
-		std::unordered_map< size_t, std::vector<size_t> > links;
-		std::map<size_t,std::map<char,size_t>> lastOcc;
+		TrieTable trie;
+		LeafTable leafSeqs;
+		LastOccTable lastOcc;
 		readDBFileMod("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs, lastOcc);
 
 		std::vector<size_t> bp = {
@@ -450,11 +1155,11 @@ TEST_CASE("modification-tolerant BPM") {
 #ifdef MUT_TOLERANT
 TEST_CASE("mutation-tolerant BPM") {
 	cfg::loadConfig("cfg/aminoacids.cfg","cfg/modifications.cfg");
-	std::map< size_t, MinMaxPST > psts;
+	MassDirectory psts;
 	MinMaxPST* leaves = nullptr;
-	std::vector< std::pair<size_t,size_t> > trie;
-	std::map< size_t, std::string > leafSeqs;
-	std::unordered_map< size_t, std::vector<size_t> > links;
+	TrieTable trie;
+	LeafTable leafSeqs;
+	LinkTable links;
 	readDBFileMut("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs, links);
 
 	// Insertion
@@ -511,6 +1216,140 @@ TEST_CASE("mutation-tolerant BPM") {
 	res = findBPMut(bp,psts,links,trie,*leaves,leafSeqs);
 	CHECK(res.size() == 1); 
 	CHECK(res.front() == "PLLSPGWGAGAAGR");
+
+	// the visitor sees the same matches and can stop the search
+	std::vector<std::string> visited;
+	auto visitNode = [&](const std::string& s, size_t r) {
+		// the node of a match has the matched sequence
+		CHECK( getProteins({r,trie.at(r).first}, *leaves, trie, leafSeqs) == s );
+		visited.push_back(s);
+		return true;
+	};
+	findBPMut(bp,psts,links,trie,*leaves,leafSeqs, visitNode);
+	CHECK(visited == res);
+	bp = { 32321, 48420 - 18608 + 13706, 19910, 28416 };	// mutation W->H in a middle block
+	visited.clear();
+	findBPMut(bp,psts,links,trie,*leaves,leafSeqs, visitNode);
+	CHECK(visited == std::vector<std::string>{ "PLLSPGWGAGAAGR" });
+	bp = { 7104, 7104 };	// A + mutation, A
+	res = findBPMut(bp,psts,links,trie,*leaves,leafSeqs);
+	REQUIRE(res.size() > 1);
+	visited.clear();
+	findBPMut(bp,psts,links,trie,*leaves,leafSeqs, [&visited](const std::string& s, size_t) { visited.push_back(s); return visited.size() < 2; });
+	CHECK(visited == std::vector<std::string>(res.begin(), res.begin()+2));
+}
+#endif
+
+#if defined(MOD_TOLERANT) && defined(MUT_TOLERANT)
+TEST_CASE("binary index file") {
+	// tests/unittest2.fasta.db is the text index of tests/unittest2.fasta with tests/mod1.cfg
+	cfg::loadConfig("cfg/aminoacids.cfg","tests/mod1.cfg");
+	const std::string binFile = "tests/unittest2.fasta.bin.db";
+	FastaReader f("tests/unittest2.fasta");
+	std::vector<std::pair<std::array<std::string,2>,size_t>> peptides;
+	std::string text;
+	f.getPeptides(30,peptides,text);
+	Trie t;
+	for (auto pep : peptides)
+		t.add(pep.first[1],pep.first[0],pep.second - pep.first[1].size());
+	std::map< size_t, std::vector< MinMaxPST_Node > > points;
+	t.getNodesByMass(points);
+
+	const size_t width = MinMaxPST::narrowestWidth(t.size());
+	CHECK( width == sizeof(uint32_t) );
+	IndexWriter out(binFile, t.size(), width);
+	for ( auto m : points )
+		out.addPST(m.first, MinMaxPST(m.second, width));
+	out.writeLeaves( MinMaxPST( t.getLeaves(), width ) );
+	std::vector< std::pair<size_t,size_t> > order;
+	t.getOrder(order);
+	const TrieTable trieTable = t.getTrieTable(width);
+	CHECK( trieTable.size() == order.size() );
+	for ( size_t i = 0; i < order.size(); i++ )
+		CHECK( trieTable.at(i) == order.at(i) );
+	out.writeTrie( trieTable );
+	const LeafTable leafTable = t.getLeafTable(text);
+	CHECK( leafTable.getText().size() == text.size() );
+	out.writeLeafSeqs( leafTable );
+	std::vector<char> lastOccOrder;
+	std::vector<size_t> lastOccTable;
+	out.writeLastOcc( lastOccOrder, t.getLastOccTable(lastOccOrder, lastOccTable) );
+	std::unordered_map< size_t, std::vector<size_t> > linkMap;
+	const LinkTable linkTable( t.computeLinks(linkMap), t.size() );
+	out.writeLinks( linkTable.getOffsets(), linkTable.getLinks() );
+	out.close();
+
+	CHECK( IndexFile::isIndexFile(binFile) );
+	CHECK( !IndexFile::isIndexFile("tests/unittest2.fasta.db") );
+
+	MassDirectory psts, binPsts;
+	MinMaxPST* leaves = nullptr;
+	MinMaxPST* binLeaves = nullptr;
+	TrieTable trie, binTrie;
+	LeafTable leafSeqs, binLeafSeqs;
+	LastOccTable lastOcc, binLastOcc;
+	readDBFileMod("tests/unittest2.fasta.db", psts, leaves, trie, leafSeqs, lastOcc);
+	readDBFileMod(binFile, binPsts, binLeaves, binTrie, binLeafSeqs, binLastOcc);
+
+	CHECK( psts.size() == binPsts.size() );
+	for ( size_t i = 0; i < psts.size(); i++ )
+		CHECK( binPsts.find(psts.getMass(i)) != nullptr && binPsts.find(psts.getMass(i))->getArray() == psts.getPST(i).getArray() );
+	CHECK( leaves->getArray() == binLeaves->getArray() );
+	CHECK( trie.size() == binTrie.size() );
+	CHECK( binTrie.getWidth() == sizeof(uint32_t) );
+	for ( size_t i = 0; i < trie.size(); i++ )
+		CHECK( trie.at(i) == binTrie.at(i) );
+	CHECK( leafSeqs.size() == binLeafSeqs.size() );
+	for ( auto l : leafSeqs.getDir() )
+		CHECK( binLeafSeqs.contains(l.preorder) && leafSeqs.at(l.preorder) == binLeafSeqs.at(l.preorder) );
+	CHECK( lastOcc.size() == binLastOcc.size() );
+	for ( size_t i = 0; i < lastOcc.size(); i++ ) {
+		CHECK( lastOcc.get(i,'C') == binLastOcc.get(i,'C') );
+		CHECK( lastOcc.get(i,'M') == binLastOcc.get(i,'M') );
+	}
+
+	// range trees instead of PSTs answer the same searches
+	const std::string treeFile = "tests/unittest2.fasta.tree.db";
+	IndexWriter treeOut(treeFile, t.size(), width, PST_LAYOUT_RANGE_TREE);
+	for ( auto m : points )
+		treeOut.addPST(m.first, MinMaxPST(m.second, width, PST_LAYOUT_RANGE_TREE));
+	treeOut.writeLeaves( MinMaxPST( t.getLeaves(), width, PST_LAYOUT_RANGE_TREE ) );
+	treeOut.writeTrie( trieTable );
+	treeOut.writeLeafSeqs( leafTable );
+	treeOut.close();
+	MassDirectory treePsts;
+	MinMaxPST* treeLeaves = nullptr;
+	TrieTable treeTrie;
+	LeafTable treeLeafSeqs;
+	readDBFile(treeFile, treePsts, treeLeaves, treeTrie, treeLeafSeqs);
+	CHECK( treePsts.size() == points.size() );
+	for ( auto m : points ) {
+		std::sort(m.second.begin(), m.second.end());
+		CHECK( (treePsts.find(m.first) != nullptr && treePsts.find(m.first)->getArray() == m.second) );
+	}
+	std::vector< MinMaxPST_Node > sortedLeaves = t.getLeaves();
+	std::sort(sortedLeaves.begin(), sortedLeaves.end());
+	CHECK( treeLeaves->getArray() == sortedLeaves );
+	for ( size_t i = 0; i < std::min<size_t>(psts.size(), 20); i++ )
+		for ( size_t j = 0; j < std::min<size_t>(psts.size(), 20); j++ ) {
+			std::vector<size_t> bp = { psts.getMass(i), psts.getMass(j) };
+			CHECK( findBP(bp, treePsts) == findBP(bp, psts) );
+		}
+	std::remove(treeFile.c_str());
+
+	LinkTable links, binLinks;
+	MassDirectory psts2, binPsts2;
+	MinMaxPST* leaves2 = nullptr;
+	MinMaxPST* binLeaves2 = nullptr;
+	TrieTable trie2, binTrie2;
+	LeafTable leafSeqs2, binLeafSeqs2;
+	readDBFileMut("tests/unittest2.fasta.db", psts2, leaves2, trie2, leafSeqs2, links);
+	readDBFileMut(binFile, binPsts2, binLeaves2, binTrie2, binLeafSeqs2, binLinks);
+	CHECK( !binLinks.empty() );
+	for ( size_t i = 0; i < trie.size(); i++ )
+		CHECK( std::vector<size_t>(links.begin(i), links.end(i)) == std::vector<size_t>(binLinks.begin(i), binLinks.end(i)) );
+
+	std::remove(binFile.c_str());
 }
 #endif
 
@@ -525,9 +1364,9 @@ void checkAllinDB( std::string file ) {
 	}
 	std::map< size_t, std::vector< MinMaxPST_Node > > points;
 	t.getNodesByMass(points);
-	std::map< size_t, MinMaxPST > psts;
+	MassDirectory psts;
 	for ( auto m : points )
-		psts.insert( std::make_pair( m.first, MinMaxPST(m.second) ));
+		psts.add( m.first, MinMaxPST(m.second) );
 
 	const size_t nrPatterns = 10;
 	const size_t patternLength = 10;
@@ -566,4 +1405,13 @@ TEST_CASE("Fasta Reader") {
 	CHECK( res.at(33).second == 61 );
 	CHECK( res.back().first[0] == "pep4" );
 	CHECK( res.back().first[1] == "L" );
+
+	std::vector<std::pair<std::array<std::string,2>,size_t>> resText;
+	std::string text;
+	f.getPeptides(60,resText,text);
+	CHECK( resText.size() == res.size() );
+	CHECK( text.substr(0,32) == "MGAPLLSPGWGAGAAGRRWWMLLAPLLPALLL" );
+	CHECK( resText.at(32).second == 32 + 60 );
+	for ( auto pep : resText )
+		CHECK( text.substr(pep.second - pep.first[1].size(), pep.first[1].size()) == pep.first[1] );
 }